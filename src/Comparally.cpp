@@ -14,12 +14,63 @@
  * - Logic outputs for AB, CD, and Pairs comparisons
  * - Visual feedback with status LEDs
  * - High-precision voltage comparison
+ * - Per-channel slew on SHIFT/SIZE CVs
+ * - Optional control-rate SHIFT/SIZE CVs with linear interpolation
+ * - Per-channel sliding median (3-31 samples) to reject input glitches
+ * - Per-channel peak/RMS/log envelope detector ahead of the comparator
+ * - Pitch mode: WIN additionally requires the input to be on a scale
+ * - Spectral mode: band level of input A from a shared block FFT
+ * - Dwell time, WIN duty cycle and crossing rate measurements
+ * - Rising/falling trigger outputs for every gate (polyphonic)
+ * - Sample & hold outputs latched on window transitions
+ * - Click-free window-gated pass-through of the inputs
+ * - WIN-entry counters with clock-divider and count outputs
+ * - Sample-exact delayed taps of every gate from a packed state history
+ * - Gate-sequence pattern matcher (shift-and NFA) with a MATCH output
+ * - Up to 16 window snapshots with a MORPH CV interpolating between them
+ * - Cable-free state bus between instances, combined on a BUS output
+ * - Adaptive per-channel hysteresis from an online noise estimate
+ * - Relative mode: a window centered on another channel's input
+ * - Linear/exponential/raised-cosine slew on the HI/WIN/LO outputs
+ * - Per-group gate output levels and polarity
+ * - Optional block processing (8/16/32 samples) with fixed latency
+ * - Window suggestions learned from the input distributions
+ * - Input recording to file and deterministic replay
+ * - Gate and flip-flop state persisted with the patch
+ * - Expansion jacks on the 10HP ComparallyExpander placed to its right
  */
 
 #include "plugin.hpp"
 #include "CustomKnob.hpp"
+#include "ComparallyExpander.hpp"
+#include "MedianFilter.hpp"
+#include "StateBlob.hpp"
+#include "InputAnalysis.hpp"
+#include "InputRecording.hpp"
+#include "PatternMatcher.hpp"
+#include "StateBus.hpp"
 #include "componentlibrary.hpp"
 #include <algorithm>
+#include <thread>
+#include <osdialog.h>
+#include <pffft.h>
+
+// EMA time constants (s) selectable for the measurement outputs
+static const int NUM_MEASURE_WINDOWS = 3;
+static const float MEASURE_WINDOW_TIMES[NUM_MEASURE_WINDOWS] = {0.1f, 1.f, 10.f};
+
+// Input channel names, for parameter labels and menus
+static const char* const CHANNEL_NAMES[4] = {"A", "B", "C", "D"};
+
+// Pattern matcher names of the packed state bits, in Comparally::StateBits order
+static const char* const STATE_BIT_NAMES[] = {
+    "A_HI", "B_HI", "C_HI", "D_HI",
+    "A_WIN", "B_WIN", "C_WIN", "D_WIN",
+    "A_LO", "B_LO", "C_LO", "D_LO",
+    "AB_AND", "AB_OR", "AB_XOR", "AB_FF",
+    "CD_AND", "CD_OR", "CD_XOR", "CD_FF",
+    "PAIRS_AND", "PAIRS_OR", "PAIRS_XOR",
+};
 
 struct Comparally : Module {
     enum ParamIds {
@@ -31,6 +82,46 @@ struct Comparally : Module {
         C_SIZE_PARAM,
         D_SHIFT_PARAM,
         D_SIZE_PARAM,
+        // CV slew (context menu)
+        A_SLEW_PARAM,
+        B_SLEW_PARAM,
+        C_SLEW_PARAM,
+        D_SLEW_PARAM,
+        // Envelope detector ballistics (context menu)
+        DETECTOR_ATTACK_PARAM,
+        DETECTOR_RELEASE_PARAM,
+        // Pitch mode note hysteresis (context menu)
+        PITCH_HYSTERESIS_PARAM,
+        // Spectral mode band edges, 20 Hz * 1000^x (context menu)
+        A_BAND_LOW_PARAM,
+        A_BAND_HIGH_PARAM,
+        B_BAND_LOW_PARAM,
+        B_BAND_HIGH_PARAM,
+        C_BAND_LOW_PARAM,
+        C_BAND_HIGH_PARAM,
+        D_BAND_LOW_PARAM,
+        D_BAND_HIGH_PARAM,
+        // Delayed gate taps (context menu)
+        DELAY_PARAM,
+        LOGIC_DELAY_PARAM,
+        // WIN-entry divisions (context menu)
+        A_DIVISION_PARAM,
+        B_DIVISION_PARAM,
+        C_DIVISION_PARAM,
+        D_DIVISION_PARAM,
+        // Comparator hysteresis (context menu)
+        HYSTERESIS_PARAM,
+        // Adaptive hysteresis, in standard deviations of the noise (context menu)
+        ADAPTIVE_HYSTERESIS_PARAM,
+        // HI/WIN/LO output slew time (context menu)
+        OUTPUT_SLEW_PARAM,
+        // Gate output levels per OutputGroup (context menu)
+        CHANNELS_HIGH_PARAM,
+        CHANNELS_LOW_PARAM,
+        LOGIC_HIGH_PARAM,
+        LOGIC_LOW_PARAM,
+        EXPANSION_HIGH_PARAM,
+        EXPANSION_LOW_PARAM,
         NUM_PARAMS
     };
     enum InputIds {
@@ -107,20 +198,730 @@ struct Comparally : Module {
         NUM_LIGHTS
     };
 
-    // per-channel state
-    bool aHi = false, aWin = false, aLo = false;
-    bool bHi = false, bWin = false, bLo = false;
-    bool cHi = false, cWin = false, cLo = false;
-    bool dHi = false, dWin = false, dLo = false;
+    // Bit layout of the packed state word. Channel bits are grouped by region
+    // (bit = region * 4 + channel) so each group of four lines up with the
+    // A..D lanes of a float_4; logic bits follow in OutputIds order.
+    enum StateBits {
+        HI_BIT = 0,     // bits 0-3: A..D above window
+        WIN_BIT = 4,    // bits 4-7: A..D inside window
+        LO_BIT = 8,     // bits 8-11: A..D below window
+        AB_AND_BIT = 12,
+        AB_OR_BIT,
+        AB_XOR_BIT,
+        AB_FF_BIT,
+        CD_AND_BIT,
+        CD_OR_BIT,
+        CD_XOR_BIT,
+        CD_FF_BIT,
+        PAIRS_AND_BIT,
+        PAIRS_OR_BIT,
+        PAIRS_XOR_BIT,
+        NUM_STATE_BITS
+    };
+
+    // Version tag written at the start of the runtime state blob. Bump it
+    // whenever fields are appended; dataFromJson() reads a field group only
+    // when the stored version is at least the one that added it.
+    //  1 kernelState             5 detectorEnv
+    //  2 Shift/Size CV smoothing 6 rawWinBits, pitchMatchBits
+    //  3 dwell, duty, rate       7 entryCounts, selectedBits
+    //  4 sampleHeld              8 noise estimator
+    static const uint32_t STATE_BLOB_VERSION = 8;
+
+    // Packed runtime state: latched HI/WIN/LO per channel plus pair logic.
+    // The XOR bits double as the previous XOR value for the flip-flops.
+    // kernelState is the comparator's own state; state is the word last
+    // emitted at the outputs (older by the block latency in block mode).
+    uint32_t kernelState = 0;
+    uint32_t state = 0;
+    // The comparator's own WIN lanes; differ from kernelState's WIN bits
+    // only for pitch-mode channels whose input is off the scale
+    uint32_t rawWinBits = 0;
+
+    // One frame of comparator input, gathered at the sample rate
+    struct Frame {
+        simd::float_4 in;        // normalized signal inputs A..D
+        simd::float_4 shiftCv;
+        simd::float_4 sizeCv;
+        float reset;             // expander RESET
+        float morph;             // expander MORPH, NaN while unpatched
+    };
+
+    // Block mode: frames are buffered and processed blockSize at a time,
+    // double-buffered so one block is emitted while the next is collected.
+    // Rack still calls process() once per sample, so input reading and
+    // output writing stay per sample. The comparator kernel and the polling
+    // of settings and handoffs run once per block (roughly 40% less CPU per
+    // sample at 16-32 in a headless benchmark).
+    static const int MAX_BLOCK_SIZE = 32;
+    int blockSize = 1;           // requested from the UI; 1 = per-sample
+    int activeBlockSize = 1;     // block size the buffers are running at
+    int blockPos = 0;
+    int blockBuffer = 0;
+    Frame blockFrames[2][MAX_BLOCK_SIZE];
+    uint32_t blockStates[2][MAX_BLOCK_SIZE] = {};
+
+    // Control-rate CVs: on one sample in cvDivider the kernel computes the
+    // window edges from that sample's SHIFT/SIZE CVs and knobs, then steps
+    // the edges linearly toward them over the next cvDivider samples. The
+    // samples in between skip the center/size/edge math. 1 = every sample.
+    int cvDivider = 1;
+    int cvCounter = 0;
+    simd::float_4 cvHiEdge = 0.f;
+    simd::float_4 cvLoEdge = 0.f;
+    simd::float_4 cvHiStep = 0.f;
+    simd::float_4 cvLoStep = 0.f;
+    bool cvEdgesValid = false;    // cvHiEdge/cvLoEdge hold real edges yet
+
+    // One-pole smoothing of SHIFT/SIZE CVs, lanes A..D
+    simd::float_4 shiftCvSmooth = 0.f;
+    simd::float_4 sizeCvSmooth = 0.f;
+    simd::float_4 slewCoef = 1.f;     // 1 = pass-through
+    simd::float_4 slewCoefDivided = 1.f;  // the same over cvDivider samples
+    simd::float_4 slewTimes = -1.f;   // slew settings slewCoef was computed for
+    float slewSampleRate = 0.f;
+    int slewDivider = 0;
+    bool slewActive = false;
+
+    // Sliding median in front of the detector
+    MedianFilter median;
+    std::atomic<int> medianLengths[4] = {{1}, {1}, {1}, {1}};  // requested by the UI, 1 = off
+
+    // UI thread: takes effect at the next updateMedian()
+    void setMedianLength(int c, int length) {
+        medianLengths[c].store(length, std::memory_order_relaxed);
+    }
+
+    void updateMedian() {
+        int lengths[4];
+        for (int c = 0; c < 4; c++) {
+            lengths[c] = medianLengths[c].load(std::memory_order_relaxed);
+        }
+        median.setLengths(lengths);
+    }
+
+    // Envelope detector in front of the comparator, lanes A..D
+    enum DetectorMode {
+        DETECTOR_OFF,
+        DETECTOR_PEAK,
+        DETECTOR_RMS,
+        DETECTOR_LOG,
+        DETECTOR_SPECTRAL,
+        NUM_DETECTOR_MODES
+    };
+    // Requested by the UI
+    std::atomic<int> detectorModes[4] = {{DETECTOR_OFF}, {DETECTOR_OFF}, {DETECTOR_OFF}, {DETECTOR_OFF}};
+    // Modes in effect, and the lane masks derived from them, audio thread only
+    int detectorMaskModes[4] = {DETECTOR_OFF, DETECTOR_OFF, DETECTOR_OFF, DETECTOR_OFF};
+    simd::float_4 detectorOn = 0.f;
+    simd::float_4 detectorRms = 0.f;
+    simd::float_4 detectorLog = 0.f;
+    simd::float_4 detectorSpectral = 0.f;
+    bool detectorActive = false;
+    bool detectorLogActive = false;
+    bool detectorSpectralActive = false;
+    simd::float_4 detectorEnv = 0.f;
+    float detectorAttackCoef = 1.f;
+    float detectorReleaseCoef = 1.f;
+    float detectorTimes[2] = {-1.f, -1.f};   // attack/release the coefficients were computed for
+    float detectorSampleRate = 0.f;
+
+    // Pitch mode: WIN also requires the input (V/oct, 0 V = C) to sit on one
+    // of the channel's 12 scale degrees. Membership is one lookup per
+    // sample in a per-channel table indexed by cents within the octave.
+    static const int CENTS_PER_OCTAVE = 1200;
+    enum PitchTableBits {
+        PITCH_INNER = 1,    // on a scale note, by more than the hysteresis
+        PITCH_OUTER = 2     // within the hysteresis of a scale note
+    };
+    // Set on the UI thread, read by the kernel
+    std::atomic<bool> pitchModes[4] = {{false}, {false}, {false}, {false}};
+    std::atomic<uint32_t> pitchOnBits{0};   // channel nibble derived from pitchModes
+    uint32_t pitchMatchBits = 0;        // latched scale membership per channel
+    // Lookup for all four channels. Rebuilt on the UI thread whenever a
+    // scale or the pitch hysteresis changes and handed over whole, since a
+    // rebuild is far too slow for process().
+    struct PitchTables {
+        uint8_t entries[4][CENTS_PER_OCTAVE];
+    };
+    int scaleMasks[4] = {0xfff, 0xfff, 0xfff, 0xfff};   // UI thread, bit n = semitone n above C
+    PitchTables pitchTablesBuilt;                       // UI thread
+    int pitchTableMasks[4] = {-1, -1, -1, -1};          // masks pitchTablesBuilt was built for
+    float pitchTableHysteresis = -1.f;
+    Handoff<PitchTables> pitchTablesHandoff;
+    PitchTables* pitchTables = nullptr;                 // audio thread
+
+    // UI thread
+    void setPitchMode(int c, bool enabled) {
+        pitchModes[c].store(enabled, std::memory_order_relaxed);
+        uint32_t bits = 0;
+        for (int i = 0; i < 4; i++) {
+            if (pitchModes[i].load(std::memory_order_relaxed))
+                bits |= 1u << i;
+        }
+        pitchOnBits.store(bits, std::memory_order_relaxed);
+    }
+
+    // Adaptive hysteresis: per channel, the running mean and mean square
+    // of the first difference of the compared level give the variance of
+    // the sample-to-sample noise. Hysteresis follows a multiple of its
+    // standard deviation, within fixed bounds.
+    static constexpr float ADAPTIVE_TIME = 0.1f;        // s, estimator time constant
+    static constexpr float ADAPTIVE_MIN = 0.001f;       // V
+    static constexpr float ADAPTIVE_MAX = 1.f;          // V
+    // Set on the UI thread, read by the kernel
+    std::atomic<bool> adaptiveModes[4] = {{false}, {false}, {false}, {false}};
+    std::atomic<uint32_t> adaptiveBits{0};  // channel nibble derived from adaptiveModes
+    simd::float_4 noisePrev = 0.f;      // previous level
+    simd::float_4 noiseMean = 0.f;      // running mean of the difference
+    simd::float_4 noiseSquare = 0.f;    // running mean of its square
+    float noiseCoef = 1.f;
+    float noiseSampleRate = 0.f;
+
+    // Relative mode: a channel's window center follows another channel's
+    // compared level. relativeWeights[s] has lane c set to 1 when channel c
+    // takes source s, so the reference for all channels is four broadcast
+    // multiply-adds, with no per-lane indexing in the loop.
+    // Source channel requested by the UI, -1 = absolute
+    std::atomic<int> relativeSources[4] = {{-1}, {-1}, {-1}, {-1}};
+    // Sources in effect, and the weights derived from them, audio thread only
+    int relativeWeightSources[4] = {-1, -1, -1, -1};
+    simd::float_4 relativeWeights[4] = {};
+    bool relativeActive = false;
+
+    // UI thread: takes effect at the next updateRelative()
+    void setRelativeSource(int c, int source) {
+        relativeSources[c].store((source == c) ? -1 : source, std::memory_order_relaxed);
+    }
+
+    // Rebuilds the weights when a requested source changed
+    void updateRelative() {
+        bool changed = false;
+        for (int c = 0; c < 4; c++) {
+            int source = relativeSources[c].load(std::memory_order_relaxed);
+            changed |= source != relativeWeightSources[c];
+            relativeWeightSources[c] = source;
+        }
+        if (!changed)
+            return;
+
+        simd::float_4 sources((float) relativeWeightSources[0], (float) relativeWeightSources[1],
+                              (float) relativeWeightSources[2], (float) relativeWeightSources[3]);
+        for (int s = 0; s < 4; s++) {
+            relativeWeights[s] = simd::ifelse(sources == (float) s, 1.f, 0.f);
+        }
+        relativeActive = simd::movemask(sources >= 0.f) != 0;
+    }
+
+    // UI thread
+    void setAdaptiveMode(int c, bool enabled) {
+        adaptiveModes[c].store(enabled, std::memory_order_relaxed);
+        uint32_t bits = 0;
+        for (int i = 0; i < 4; i++) {
+            if (adaptiveModes[i].load(std::memory_order_relaxed))
+                bits |= 1u << i;
+        }
+        adaptiveBits.store(bits, std::memory_order_relaxed);
+    }
+
+    // UI thread: takes effect at the next updateDetectorModes()
+    void setDetectorMode(int c, int mode) {
+        detectorModes[c].store(mode, std::memory_order_relaxed);
+    }
+
+    // Rebuilds the detector lane masks when a requested mode changed
+    void updateDetectorModes() {
+        bool changed = false;
+        for (int c = 0; c < 4; c++) {
+            int mode = detectorModes[c].load(std::memory_order_relaxed);
+            changed |= mode != detectorMaskModes[c];
+            detectorMaskModes[c] = mode;
+        }
+        if (!changed)
+            return;
+
+        simd::float_4 modes((float) detectorMaskModes[0], (float) detectorMaskModes[1],
+                            (float) detectorMaskModes[2], (float) detectorMaskModes[3]);
+        detectorOn = modes != (float) DETECTOR_OFF;
+        detectorRms = modes == (float) DETECTOR_RMS;
+        detectorLog = modes == (float) DETECTOR_LOG;
+        detectorSpectral = modes == (float) DETECTOR_SPECTRAL;
+        detectorActive = simd::movemask(detectorOn) != 0;
+        detectorLogActive = simd::movemask(detectorLog) != 0;
+        detectorSpectralActive = simd::movemask(detectorSpectral) != 0;
+    }
+
+    // Spectral detector: Hann-windowed FFT of input A every SPECTRAL_HOP
+    // samples, shared by all channels; each channel reads the level of its
+    // own band from prefix sums of the bin powers. The whole FFT runs inside
+    // the one sample that completes a hop, so the cost is a spike every 256
+    // samples rather than a steady load (in block mode, one block in eight
+    // at 32 samples carries it).
+    static const int SPECTRAL_SIZE = 1024;
+    static const int SPECTRAL_HOP = 256;
+    dsp::RealFFT spectralFft{SPECTRAL_SIZE};
+    float spectralHistory[SPECTRAL_SIZE] = {};
+    int spectralPos = 0;                // oldest sample in spectralHistory
+    int spectralHopCount = 0;
+    float spectralWindow[SPECTRAL_SIZE];
+    float spectralNorm = 0.f;           // band energy -> mean square
+    float* spectralIn = nullptr;        // pffft-aligned, SPECTRAL_SIZE
+    float* spectralOut = nullptr;       // pffft-aligned, SPECTRAL_SIZE
+    float spectralPrefix[SPECTRAL_SIZE / 2 + 1] = {};
+    simd::float_4 spectralLevel = -10.f;   // V/10 dB re 5 V, latest hop
+    // FFT bins of each channel's band, [c][0] low, [c][1] high
+    int spectralBins[4][2] = {};
+    float spectralBandValues[8] = {};   // band params spectralBins was computed for
+    float spectralBandSampleRate = 0.f;
+
+    // Maps the band params (0..1, log 20 Hz..20 kHz) to bins when one of
+    // them or the sample rate changed
+    void updateSpectralBands(float sampleRate) {
+        bool changed = sampleRate != spectralBandSampleRate;
+        for (int i = 0; i < 8; i++) {
+            float value = params[A_BAND_LOW_PARAM + i].getValue();
+            changed |= value != spectralBandValues[i];
+            spectralBandValues[i] = value;
+        }
+        if (!changed)
+            return;
+
+        spectralBandSampleRate = sampleRate;
+        float binsPerHz = SPECTRAL_SIZE / sampleRate;
+        for (int c = 0; c < 4; c++) {
+            // Same mapping as the params' display value: 20 Hz * 1000^x
+            float lowHz = 20.f * std::pow(1000.f, spectralBandValues[2 * c]);
+            float highHz = 20.f * std::pow(1000.f, spectralBandValues[2 * c + 1]);
+            int lowBin = clamp((int) std::round(lowHz * binsPerHz), 1, SPECTRAL_SIZE / 2 - 1);
+            spectralBins[c][0] = lowBin;
+            spectralBins[c][1] = clamp((int) std::round(highHz * binsPerHz), lowBin, SPECTRAL_SIZE / 2 - 1);
+        }
+    }
+
+    // Runs the FFT over the history and refreshes spectralLevel
+    void updateSpectrum() {
+        // Unroll the history oldest first, through the window
+        for (int i = 0; i < SPECTRAL_SIZE; i++) {
+            spectralIn[i] = spectralHistory[(spectralPos + i) & (SPECTRAL_SIZE - 1)] * spectralWindow[i];
+        }
+        spectralFft.rfft(spectralIn, spectralOut);
+
+        // spectralPrefix[k] = power of bins 1..k-1 (DC skipped); out[0..1]
+        // hold the DC and Nyquist terms, bins 1.. are interleaved re/im
+        spectralPrefix[0] = 0.f;
+        spectralPrefix[1] = 0.f;
+        for (int k = 1; k < SPECTRAL_SIZE / 2; k++) {
+            float re = spectralOut[2 * k];
+            float im = spectralOut[2 * k + 1];
+            spectralPrefix[k + 1] = spectralPrefix[k] + re * re + im * im;
+        }
+
+        simd::float_4 meanSquare;
+        for (int c = 0; c < 4; c++) {
+            meanSquare[c] = (spectralPrefix[spectralBins[c][1] + 1] - spectralPrefix[spectralBins[c][0]]) * spectralNorm;
+        }
+        // Peak of a sine with that RMS, on the Log detector's scale
+        spectralLevel = 2.f * simd::log10(simd::fmax(simd::sqrt(2.f * meanSquare), 5e-5f) * 0.2f);
+    }
+
+    // Measurements: samples in current state, WIN duty and crossing rate EMAs
+    uint32_t dwellSamples[4] = {};
+    simd::float_4 winDuty = 0.f;
+    simd::float_4 crossRate = 0.f;      // Hz
+    int measureWindow = 1;              // index into MEASURE_WINDOW_TIMES
+    simd::float_4 measureCoef = 0.f;
+    int measureCoefWindow = -1;         // window/sample rate measureCoef was computed for
+    float measureSampleRate = 0.f;
+
+    // 0/1 per lane from the low four bits of `bits` (lane i = bit i)
+    static simd::float_4 bitsToLanes(uint32_t bits) {
+        return simd::float_4(bits & 1, (bits >> 1) & 1, (bits >> 2) & 1, (bits >> 3) & 1);
+    }
+
+    // Output shaping of the 12 channel gates. Each group of four (HI, WIN,
+    // LO A..D) follows a 0..1 ramp toward its gate: linear over the slew
+    // time, a one-pole settling within it, or the linear ramp bent into a
+    // raised cosine. LEDs and the logic outputs stay unshaped.
+    enum OutputShape {
+        SHAPE_OFF,
+        SHAPE_LINEAR,
+        SHAPE_EXPONENTIAL,
+        SHAPE_COSINE,
+        NUM_OUTPUT_SHAPES
+    };
+    int outputShape = SHAPE_OFF;        // requested from the UI
+    int activeOutputShape = SHAPE_OFF;  // shape the ramps are running with
+    simd::float_4 outputRamps[3] = {};
+    float outputStep = 1.f;             // linear: ramp change per sample
+    float outputCoef = 1.f;             // exponential: one-pole coefficient
+    float outputSlewTime = -1.f;        // slew setting the above were computed for
+    float outputSampleRate = 0.f;
+
+    // Gate voltages per output group: a 0/1 gate vector x becomes
+    // low + x * span. The level vectors are rebuilt only when the levels or
+    // the inversion change; inverting swaps high and low.
+    enum OutputGroup {
+        GROUP_CHANNELS,     // HI/WIN/LO
+        GROUP_LOGIC,        // pair and pairs logic
+        GROUP_EXPANSION,    // triggers, delayed gates, DIV, MATCH, BUS
+        NUM_OUTPUT_GROUPS
+    };
+    bool outputInverted[NUM_OUTPUT_GROUPS] = {};
+    float outputHighLevels[NUM_OUTPUT_GROUPS] = {};     // after inversion
+    float outputLowLevels[NUM_OUTPUT_GROUPS] = {};
+    simd::float_4 outputHigh[NUM_OUTPUT_GROUPS] = {};
+    simd::float_4 outputLow[NUM_OUTPUT_GROUPS] = {};
+    simd::float_4 outputSpan[NUM_OUTPUT_GROUPS] = {};
+
+    // Edge trigger countdowns (s), lane = state bit (6 x 4 lanes cover 23 bits)
+    static const int NUM_TRIGGER_GROUPS = 6;
+    simd::float_4 riseTimers[NUM_TRIGGER_GROUPS] = {};
+    simd::float_4 fallTimers[NUM_TRIGGER_GROUPS] = {};
+
+    // Sample & hold: input latched per channel on the selected transition
+    enum SampleHoldMode {
+        SH_ON_ENTER,
+        SH_ON_EXIT,
+        SH_ON_ENTER_EXIT,
+        SH_ON_ANY_CHANGE,
+        NUM_SH_MODES
+    };
+    // Set on the UI thread, read per sample by renderFrame()
+    std::atomic<int> sampleHoldModes[4] = {{SH_ON_ENTER}, {SH_ON_ENTER}, {SH_ON_ENTER}, {SH_ON_ENTER}};
+    // Channel nibbles selecting which edges latch, derived from
+    // sampleHoldModes and packed into one word (enter | exit << 4 | any << 8)
+    // so the audio thread never sees half of a mode change
+    std::atomic<uint32_t> shLatchBits{0xf};
+    simd::float_4 sampleHeld = 0.f;
+
+    // UI thread
+    void setSampleHoldMode(int c, int mode) {
+        sampleHoldModes[c].store(mode, std::memory_order_relaxed);
+
+        uint32_t enterBits = 0, exitBits = 0, anyBits = 0;
+        for (int i = 0; i < 4; i++) {
+            int m = sampleHoldModes[i].load(std::memory_order_relaxed);
+            if (m == SH_ON_ENTER || m == SH_ON_ENTER_EXIT)
+                enterBits |= 1u << i;
+            if (m == SH_ON_EXIT || m == SH_ON_ENTER_EXIT)
+                exitBits |= 1u << i;
+            if (m == SH_ON_ANY_CHANGE)
+                anyBits |= 1u << i;
+        }
+        shLatchBits.store(enterBits | exitBits << 4 | anyBits << 8, std::memory_order_relaxed);
+    }
+
+    // Window-gated pass-through: input times a de-clicked WIN gain
+    simd::float_4 passGain = 0.f;
+    float passCoef = 1.f;
+    float passSampleRate = 0.f;
+
+    // Decimated feed of the compared levels for the background analysis.
+    // Registered with the analysis job only while learning is enabled; the
+    // audio thread pushes only then.
+    AnalysisFeed analysisFeed;
+    std::atomic<bool> learnInputs{false};
+    int analysisCounter = 0;
+
+    // UI thread
+    void setLearnInputs(bool enabled) {
+        if (enabled == learnInputs.load())
+            return;
+        if (enabled) {
+            // Start over rather than mix in statistics from before the pause
+            analysisFeed.resetRequested = true;
+            registerAnalysisFeed(&analysisFeed);
+        }
+        learnInputs.store(enabled, std::memory_order_relaxed);
+        if (!enabled)
+            unregisterAnalysisFeed(&analysisFeed);
+    }
+
+    // Input recording: the UI thread owns the writer job, the audio thread
+    // pushes frames to recordTarget while it is set. recordPushing brackets
+    // the audio thread's use of the pointer, so stopRecording() knows when
+    // the last frame is in the ring.
+    std::shared_ptr<InputRecorder> recorder;
+    std::atomic<InputRecorder*> recordTarget{nullptr};
+    std::atomic<bool> recordPushing{false};
+
+    // Replay: files are opened on the UI thread and handed over; an empty
+    // InputReplay switches back to the live inputs
+    Handoff<InputReplay> replayHandoff;
+    InputReplay* replay = nullptr;      // audio thread
+    std::string replayPath;             // UI thread, for the menu
+
+    // False once stopped, or once the writer gave up on a failed write
+    bool isRecording() const {
+        return recordTarget.load(std::memory_order_relaxed) && !recorder->isCancelled();
+    }
 
-    // pair logic state
-    bool abFlipFlop = false;
-    bool cdFlipFlop = false;
-    bool abXorPrevious = false;
-    bool cdXorPrevious = false;
+    // UI thread
+    void startRecording(const std::string& path) {
+        stopRecording();
+        // The previous recorder is released here at the earliest, long after
+        // the audio thread last saw it in recordTarget
+        recorder = InputRecorder::create(path, APP->engine->getSampleRate());
+        if (!recorder)
+            return;
+        schedulePeriodicJob(recorder, RECORDER_PERIOD_MS);
+        recordTarget.store(recorder.get(), std::memory_order_release);
+    }
+
+    // UI thread: waits for the audio thread to let go of the recorder, stops
+    // the writer ticks, then flushes the queued tail and closes the file
+    void stopRecording() {
+        if (!recordTarget.load(std::memory_order_relaxed))
+            return;
+        recordTarget.store(nullptr);
+        // A push that saw the old pointer set recordPushing first, and only
+        // clears it once the frame is queued (both sequentially consistent)
+        while (recordPushing.load()) {
+            std::this_thread::yield();
+        }
+        recorder->cancel();
+        recorder->wait();
+        recorder->close();
+    }
+
+    // UI thread: replays `path` in place of the inputs, or the live inputs if empty
+    void setReplay(const std::string& path) {
+        InputReplay* next = path.empty() ? new InputReplay : InputReplay::open(path);
+        if (!next)
+            return;
+        if (next->numFrames > 0 && next->sampleRate != APP->engine->getSampleRate()) {
+            WARN("Input recording %s was made at %g Hz, replaying at %g Hz", path.c_str(),
+                 next->sampleRate, APP->engine->getSampleRate());
+        }
+        replayPath = path;
+        replayHandoff.publish(next);
+    }
+
+    // Pattern matcher over the emitted gate edges. Patterns are compiled on
+    // the UI thread and handed over; an empty program turns matching off.
+    enum MatchMode {
+        MATCH_TRIGGER,
+        MATCH_GATE,         // high until the last step's edge reverts
+        NUM_MATCH_MODES
+    };
+    Handoff<PatternProgram> patternHandoff;
+    PatternProgram* pattern = nullptr;  // audio thread
+    PatternMatcher patternMatcher;
+    int matchMode = MATCH_TRIGGER;
+    float matchTimer = 0.f;
+    bool matchGate = false;
+    std::string patternText;            // UI thread
+    std::string patternError;           // UI thread, last compile error
+
+    // UI thread: compiles `text` and hands it to the audio thread. On a
+    // syntax error the running pattern is kept.
+    void setPattern(const std::string& text) {
+        PatternProgram* program = new PatternProgram;
+        if (!compilePattern(text, STATE_BIT_NAMES, NUM_STATE_BITS, program, &patternError)) {
+            delete program;
+            return;
+        }
+        patternError = "";
+        patternText = text;
+        patternHandoff.publish(program);
+    }
+
+    // WIN-entry counters: entry k of a channel (k counted from 0 since the
+    // last reset) is selected when k % division == 0. DIV passes the WIN
+    // gate of selected entries; COUNT is 10 V * (count / division).
+    uint32_t entryCounts[4] = {};
+    uint32_t selectedBits = 0;          // channel nibble: current entry selected
+    dsp::SchmittTrigger resetTrigger;
+
+    // Window snapshots: stored SHIFT/SIZE/hysteresis settings. With MORPH
+    // patched, 0-10 V sweeps from the first to the last snapshot in place of
+    // the knobs. The table is edited on the UI thread and handed over whole;
+    // it is laid out per field and also holds each entry's difference to
+    // the next, so a morph costs one multiply-add per value.
+    static const int MAX_SNAPSHOTS = 16;
+    struct SnapshotTable {
+        simd::float_4 shift[MAX_SNAPSHOTS];
+        simd::float_4 size[MAX_SNAPSHOTS];
+        float hysteresis[MAX_SNAPSHOTS] = {};
+        simd::float_4 shiftStep[MAX_SNAPSHOTS];
+        simd::float_4 sizeStep[MAX_SNAPSHOTS];
+        float hysteresisStep[MAX_SNAPSHOTS] = {};
+        int count = 0;
+
+        void updateSteps() {
+            for (int i = 0; i < count; i++) {
+                int j = std::min(i + 1, count - 1);
+                shiftStep[i] = shift[j] - shift[i];
+                sizeStep[i] = size[j] - size[i];
+                hysteresisStep[i] = hysteresis[j] - hysteresis[i];
+            }
+        }
+    };
+    SnapshotTable snapshots;                    // UI thread
+    Handoff<SnapshotTable> snapshotHandoff;
+    SnapshotTable* morphTable = nullptr;        // audio thread
+    // Morph result, recomputed only when the position changes
+    float morphPosition = -1.f;
+    simd::float_4 morphShift = 0.f;
+    simd::float_4 morphSize = 0.f;
+    float morphHysteresis = 0.f;
+
+    // UI thread: hands a copy of the edited table to the audio thread
+    void publishSnapshots() {
+        snapshots.updateSteps();
+        snapshotHandoff.publish(new SnapshotTable(snapshots));
+    }
+
+    // UI thread: stores the knobs as snapshot `index`, appending if index == count
+    void storeSnapshot(int index) {
+        if (index < 0 || index > snapshots.count || index >= MAX_SNAPSHOTS)
+            return;
+        for (int c = 0; c < 4; c++) {
+            snapshots.shift[index][c] = params[A_SHIFT_PARAM + 2 * c].getValue();
+            snapshots.size[index][c] = params[A_SIZE_PARAM + 2 * c].getValue();
+        }
+        snapshots.hysteresis[index] = params[HYSTERESIS_PARAM].getValue();
+        if (index == snapshots.count)
+            snapshots.count++;
+        publishSnapshots();
+    }
+
+    // UI thread: sets the knobs to snapshot `index`
+    void recallSnapshot(int index) {
+        if (index < 0 || index >= snapshots.count)
+            return;
+        for (int c = 0; c < 4; c++) {
+            paramQuantities[A_SHIFT_PARAM + 2 * c]->setValue(snapshots.shift[index][c]);
+            paramQuantities[A_SIZE_PARAM + 2 * c]->setValue(snapshots.size[index][c]);
+        }
+        paramQuantities[HYSTERESIS_PARAM]->setValue(snapshots.hysteresis[index]);
+    }
+
+    // UI thread: removes snapshot `index`, moving the later ones down
+    void removeSnapshot(int index) {
+        if (index < 0 || index >= snapshots.count)
+            return;
+        for (int i = index; i + 1 < snapshots.count; i++) {
+            snapshots.shift[i] = snapshots.shift[i + 1];
+            snapshots.size[i] = snapshots.size[i + 1];
+            snapshots.hysteresis[i] = snapshots.hysteresis[i + 1];
+        }
+        snapshots.count--;
+        publishSnapshots();
+    }
+
+    // Interpolates the window settings at `voltage` on the MORPH input
+    void updateMorph(float voltage) {
+        float position = clamp(voltage * 0.1f, 0.f, 1.f) * (morphTable->count - 1);
+        if (position == morphPosition)
+            return;
+
+        morphPosition = position;
+        int i = std::min((int) position, morphTable->count - 1);
+        float frac = position - i;
+        morphShift = morphTable->shift[i] + morphTable->shiftStep[i] * frac;
+        morphSize = morphTable->size[i] + morphTable->sizeStep[i] * frac;
+        morphHysteresis = morphTable->hysteresis[i] + morphTable->hysteresisStep[i] * frac;
+    }
+
+    // State bus: the emitted state word is published to one plugin-global
+    // slot and another slot is read back, one sample old (-1 = off)
+    int busPublishSlot = -1;
+    int busListenSlot = -1;
+    int busPublishedSlot = -1;          // audio thread: slot last written
+
+    // History of emitted state words for the delayed taps, one word per
+    // sample so the delays are sample-exact. The ring is a fixed 2^17 words
+    // (512 KB) per instance: the full 2 s up to 48 kHz; at higher rates the
+    // delay is capped at what the ring holds (1.36 s at 96 kHz).
+    static constexpr float MAX_DELAY = 2.f;    // s
+    static const uint32_t HISTORY_SIZE = 1 << 17;
+    std::vector<uint32_t> history;
+    uint32_t historyPos = 0;            // next slot to write
+
+    // Fills the history with the current state, so a tap never reads
+    // words from before the module existed or from another sample rate
+    void clearHistory() {
+        std::fill(history.begin(), history.end(), state);
+        historyPos = 0;
+    }
+
+    // Adds this sample's state word to the history
+    void pushHistory() {
+        history[historyPos] = state;
+        historyPos = (historyPos + 1) & (HISTORY_SIZE - 1);
+    }
+
+    // Writes one poly channel per state bit, from `firstBit` on, delayed by
+    // `delay` seconds rounded to whole samples
+    void renderDelayTap(int outputId, int firstBit, int numBits, float delay, float sampleRate) {
+        uint32_t samples = std::min((uint32_t) (delay * sampleRate + 0.5f), HISTORY_SIZE - 1);
+        uint32_t past = history[(historyPos - 1 - samples) & (HISTORY_SIZE - 1)] >> firstBit;
+        expansionOutputs[outputId].setChannels(numBits);
+        for (int c = 0; c < numBits; c += 4) {
+            simd::float_4 gates = bitsToLanes(past >> c);
+            expansionOutputs[outputId].setVoltageSimd(outputLow[GROUP_EXPANSION] + gates * outputSpan[GROUP_EXPANSION], c);
+        }
+    }
+
+    // Expansion jacks: they sit on a ComparallyExpander to the right. The
+    // output stage renders into these stand-ins, connected exactly when the
+    // expander reports the jack patched, and the inputs mirror the
+    // expander's; both sides see the other one sample late.
+    typedef ComparallyExpander Expander;
+    engine::Output expansionOutputs[Expander::NUM_OUTPUTS];
+    engine::Input expansionInputs[Expander::NUM_INPUTS];
+    // Receive buffers for the messages from the expander on the right
+    Expander::InputMessage expanderMessages[2];
+
+    bool hasExpander() {
+        return rightExpander.module && rightExpander.module->model == modelComparallyExpander;
+    }
+
+    // Takes the expander's inputs and patched outputs from its last message
+    void receiveExpander() {
+        const Expander::InputMessage* message = hasExpander() ? (const Expander::InputMessage*) rightExpander.consumerMessage : nullptr;
+        for (int i = 0; i < Expander::NUM_INPUTS; i++) {
+            bool connected = message && message->inputConnected[i];
+            expansionInputs[i].channels = connected ? 1 : 0;
+            expansionInputs[i].setVoltage(connected ? message->voltages[i] : 0.f);
+        }
+        // Like the engine: an output keeps the channel count it was last
+        // given while patched, and drops to 0 when unpatched
+        for (int i = 0; i < Expander::NUM_OUTPUTS; i++) {
+            if (!(message && message->outputConnected[i]))
+                expansionOutputs[i].channels = 0;
+            else if (expansionOutputs[i].channels == 0)
+                expansionOutputs[i].channels = 1;
+        }
+    }
+
+    // Hands this sample's expansion outputs to the expander
+    void sendExpander() {
+        if (!hasExpander())
+            return;
+        Expander::OutputMessage* message = (Expander::OutputMessage*) rightExpander.module->leftExpander.producerMessage;
+        for (int i = 0; i < Expander::NUM_OUTPUTS; i++) {
+            int channels = expansionOutputs[i].channels;
+            message->channels[i] = channels;
+            std::copy(expansionOutputs[i].voltages, expansionOutputs[i].voltages + channels, message->voltages[i]);
+        }
+        rightExpander.module->leftExpander.requestMessageFlip();
+    }
+
+    // Output (and light) id driven by a state bit
+    static int stateOutputId(int bit) {
+        if (bit < AB_AND_BIT) {
+            return (bit & 3) * 3 + (bit >> 2);
+        }
+        return bit;
+    }
 
     Comparally() {
         config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
+        history.resize(HISTORY_SIZE);
+        rightExpander.producerMessage = &expanderMessages[0];
+        rightExpander.consumerMessage = &expanderMessages[1];
 
         // SHIFT knobs (±5 V)
         configParam(A_SHIFT_PARAM, -5.f, 5.f, 0.f, "A Shift (center)", " V");
@@ -134,6 +935,61 @@ struct Comparally : Module {
         configParam(C_SIZE_PARAM, 0.f, 10.f, 1.f, "C Size (width)", " V");
         configParam(D_SIZE_PARAM, 0.f, 10.f, 1.f, "D Size (width)", " V");
 
+        // CV slew time constants (0 = off)
+        configParam(A_SLEW_PARAM, 0.f, 1.f, 0.f, "A CV slew", " ms", 0.f, 1000.f);
+        configParam(B_SLEW_PARAM, 0.f, 1.f, 0.f, "B CV slew", " ms", 0.f, 1000.f);
+        configParam(C_SLEW_PARAM, 0.f, 1.f, 0.f, "C CV slew", " ms", 0.f, 1000.f);
+        configParam(D_SLEW_PARAM, 0.f, 1.f, 0.f, "D CV slew", " ms", 0.f, 1000.f);
+
+        // Envelope detector attack/release, shared by all channels
+        configParam(DETECTOR_ATTACK_PARAM, 0.0001f, 0.1f, 0.001f, "Detector attack", " ms", 0.f, 1000.f);
+        configParam(DETECTOR_RELEASE_PARAM, 0.001f, 1.f, 0.05f, "Detector release", " ms", 0.f, 1000.f);
+
+        // Pitch mode: cents past the half-semitone boundary before a note is left
+        configParam(PITCH_HYSTERESIS_PARAM, 0.f, 25.f, 5.f, "Pitch hysteresis", " cents");
+
+        // Spectral bands, log scale 20 Hz..20 kHz; defaults kick/bass/mids/highs
+        static const float bandDefaults[4][2] = {{0.f, 0.27f}, {0.27f, 0.6f}, {0.6f, 0.8f}, {0.8f, 1.f}};
+        for (int c = 0; c < 4; c++) {
+            configParam(A_BAND_LOW_PARAM + 2 * c, 0.f, 1.f, bandDefaults[c][0],
+                        string::f("%s band low", CHANNEL_NAMES[c]), " Hz", 1000.f, 20.f);
+            configParam(A_BAND_HIGH_PARAM + 2 * c, 0.f, 1.f, bandDefaults[c][1],
+                        string::f("%s band high", CHANNEL_NAMES[c]), " Hz", 1000.f, 20.f);
+        }
+
+        // WIN-entry divisions
+        for (int c = 0; c < 4; c++) {
+            configParam(A_DIVISION_PARAM + c, 1.f, 16.f, 2.f, string::f("%s entry division", CHANNEL_NAMES[c]))->snapEnabled = true;
+        }
+
+        // Delayed gate taps
+        configParam(DELAY_PARAM, 0.f, MAX_DELAY, 0.f, "Gate delay", " ms", 0.f, 1000.f);
+        configParam(LOGIC_DELAY_PARAM, 0.f, MAX_DELAY, 0.f, "Logic delay", " ms", 0.f, 1000.f);
+
+        // Comparator hysteresis: the input must pass an edge by this much to switch
+        configParam(HYSTERESIS_PARAM, 0.f, 1.f, 0.1f, "Hysteresis", " mV", 0.f, 1000.f);
+        configParam(ADAPTIVE_HYSTERESIS_PARAM, 1.f, 10.f, 3.f, "Adaptive hysteresis", " x noise");
+
+        // HI/WIN/LO output slew, used when an output shape is selected
+        configParam(OUTPUT_SLEW_PARAM, 0.0001f, 0.1f, 0.005f, "Gate output slew", " ms", 0.f, 1000.f);
+
+        // Gate output levels
+        static const char* const groupNames[NUM_OUTPUT_GROUPS] = {"HI/WIN/LO", "Logic", "Expansion"};
+        for (int g = 0; g < NUM_OUTPUT_GROUPS; g++) {
+            configParam(CHANNELS_HIGH_PARAM + 2 * g, -10.f, 10.f, 10.f, string::f("%s gate high", groupNames[g]), " V");
+            configParam(CHANNELS_LOW_PARAM + 2 * g, -10.f, 10.f, 0.f, string::f("%s gate low", groupNames[g]), " V");
+        }
+
+        spectralIn = (float*) pffft_aligned_malloc(sizeof(float) * SPECTRAL_SIZE);
+        spectralOut = (float*) pffft_aligned_malloc(sizeof(float) * SPECTRAL_SIZE);
+        float windowPower = 0.f;
+        for (int i = 0; i < SPECTRAL_SIZE; i++) {
+            spectralWindow[i] = 0.5f * (1.f - std::cos(2.f * M_PI * i / SPECTRAL_SIZE));
+            windowPower += spectralWindow[i] * spectralWindow[i];
+        }
+        // Bins 1..N/2-1 carry half of Parseval's sum, hence the 2
+        spectralNorm = 2.f / (SPECTRAL_SIZE * windowPower);
+
         // Inputs
         configInput(A_IN_INPUT, "A In");
         configInput(A_SHIFT_CV_INPUT, "A Shift CV");
@@ -207,104 +1063,1111 @@ struct Comparally : Module {
         configLight(PAIRS_AND_LIGHT, "Pairs AND");
         configLight(PAIRS_OR_LIGHT,  "Pairs OR");
         configLight(PAIRS_XOR_LIGHT, "Pairs XOR");
+
+        publishPitchTables();
     }
 
-    void process(const ProcessArgs& args) override {
-        const float H = 0.1f; // hysteresis in volts
+    ~Comparally() {
+        setLearnInputs(false);
+        stopRecording();
+        delete replay;
+        pffft_aligned_free(spectralIn);
+        pffft_aligned_free(spectralOut);
+        delete pattern;
+        delete morphTable;
+        delete pitchTables;
+        if (busPublishedSlot >= 0)
+            busLeave(busPublishedSlot);
+    }
+
+    // Recomputes the CV smoothing coefficients when the slew settings, the
+    // sample rate or the CV divider change. k = 1 - exp(-1 / (tau * fs));
+    // tau = 0 passes through. At control rate one step spans cvDivider samples.
+    void updateSlew(float sampleRate) {
+        simd::float_4 times(params[A_SLEW_PARAM].getValue(), params[B_SLEW_PARAM].getValue(),
+                            params[C_SLEW_PARAM].getValue(), params[D_SLEW_PARAM].getValue());
+        if (simd::movemask(times != slewTimes) == 0 && sampleRate == slewSampleRate && cvDivider == slewDivider)
+            return;
+
+        slewTimes = times;
+        slewSampleRate = sampleRate;
+        slewDivider = cvDivider;
+        for (int c = 0; c < 4; c++) {
+            slewCoef[c] = (times[c] > 0.f) ? 1.f - std::exp(-1.f / (times[c] * sampleRate)) : 1.f;
+            slewCoefDivided[c] = (times[c] > 0.f) ? 1.f - std::exp(-cvDivider / (times[c] * sampleRate)) : 1.f;
+        }
+        slewActive = simd::movemask(times > 0.f) != 0;
+    }
+
+    // Attack/release coefficients of the envelope detector, same form as the slew
+    void updateDetector(float sampleRate) {
+        float attack = params[DETECTOR_ATTACK_PARAM].getValue();
+        float release = params[DETECTOR_RELEASE_PARAM].getValue();
+        if (attack == detectorTimes[0] && release == detectorTimes[1] && sampleRate == detectorSampleRate)
+            return;
+
+        detectorTimes[0] = attack;
+        detectorTimes[1] = release;
+        detectorSampleRate = sampleRate;
+        detectorAttackCoef = 1.f - std::exp(-1.f / (attack * sampleRate));
+        detectorReleaseCoef = 1.f - std::exp(-1.f / (release * sampleRate));
+    }
+
+    // UI thread: rebuilds the pitch lookup of any channel whose scale or the
+    // hysteresis changed and hands the tables to the audio thread. Entry i
+    // classifies the pitch i cents above C.
+    void publishPitchTables() {
+        float hysteresis = params[PITCH_HYSTERESIS_PARAM].getValue();
+        bool rebuildAll = hysteresis != pitchTableHysteresis;
+        pitchTableHysteresis = hysteresis;
+
+        bool changed = false;
+        for (int c = 0; c < 4; c++) {
+            if (!rebuildAll && scaleMasks[c] == pitchTableMasks[c])
+                continue;
+
+            changed = true;
+            int mask = scaleMasks[c];
+            pitchTableMasks[c] = mask;
+            for (int i = 0; i < CENTS_PER_OCTAVE; i++) {
+                // Cent at the center of entry i, to the nearest scale note
+                float cents = i + 0.5f;
+                float distance = CENTS_PER_OCTAVE;
+                for (int n = 0; n < 12; n++) {
+                    if (!((mask >> n) & 1))
+                        continue;
+                    float d = std::fabs(cents - 100.f * n);
+                    distance = std::min(distance, std::min(d, CENTS_PER_OCTAVE - d));
+                }
+                uint8_t entry = 0;
+                if (distance <= 50.f - hysteresis)
+                    entry |= PITCH_INNER;
+                if (distance <= 50.f + hysteresis)
+                    entry |= PITCH_OUTER;
+                pitchTablesBuilt.entries[c][i] = entry;
+            }
+        }
+        if (changed)
+            pitchTablesHandoff.publish(new PitchTables(pitchTablesBuilt));
+    }
+
+    void updateMeasure(float sampleRate) {
+        if (measureWindow == measureCoefWindow && sampleRate == measureSampleRate)
+            return;
+
+        measureCoefWindow = measureWindow;
+        measureSampleRate = sampleRate;
+        measureCoef = 1.f - std::exp(-1.f / (MEASURE_WINDOW_TIMES[measureWindow] * sampleRate));
+    }
+
+    void updateOutputLevels() {
+        for (int g = 0; g < NUM_OUTPUT_GROUPS; g++) {
+            float high = params[CHANNELS_HIGH_PARAM + 2 * g].getValue();
+            float low = params[CHANNELS_LOW_PARAM + 2 * g].getValue();
+            if (outputInverted[g])
+                std::swap(high, low);
+            if (high == outputHighLevels[g] && low == outputLowLevels[g])
+                continue;
+
+            outputHighLevels[g] = high;
+            outputLowLevels[g] = low;
+            outputHigh[g] = high;
+            outputLow[g] = low;
+            outputSpan[g] = high - low;
+        }
+    }
+
+    // Switches the output shape (starting the ramps at the current gates)
+    // and recomputes its coefficients when the slew or sample rate change.
+    // The one-pole's time constant is a fifth of the slew time.
+    void updateOutputShape(float sampleRate) {
+        if (outputShape != activeOutputShape) {
+            if (activeOutputShape == SHAPE_OFF) {
+                for (int g = 0; g < 3; g++) {
+                    outputRamps[g] = bitsToLanes(state >> (4 * g));
+                }
+            }
+            activeOutputShape = outputShape;
+        }
+
+        float time = params[OUTPUT_SLEW_PARAM].getValue();
+        if (time == outputSlewTime && sampleRate == outputSampleRate)
+            return;
+
+        outputSlewTime = time;
+        outputSampleRate = sampleRate;
+        outputStep = std::min(1.f / (time * sampleRate), 1.f);
+        outputCoef = 1.f - std::exp(-5.f / (time * sampleRate));
+    }
+
+    void updateNoise(float sampleRate) {
+        if (sampleRate == noiseSampleRate)
+            return;
+
+        noiseSampleRate = sampleRate;
+        noiseCoef = 1.f - std::exp(-1.f / (ADAPTIVE_TIME * sampleRate));
+    }
+
+    // Anti-click ramp for the pass outputs: one-pole with a 1 ms time constant
+    void updatePassRamp(float sampleRate) {
+        if (sampleRate == passSampleRate)
+            return;
+
+        passSampleRate = sampleRate;
+        passCoef = 1.f - std::exp(-1.f / (1e-3f * sampleRate));
+    }
+
+    void onSampleRateChange(const SampleRateChangeEvent& e) override {
+        updateSlew(e.sampleRate);
+        updateDetector(e.sampleRate);
+        updateMeasure(e.sampleRate);
+        updateNoise(e.sampleRate);
+        updateOutputShape(e.sampleRate);
+        updatePassRamp(e.sampleRate);
+        patternMatcher.setSampleRate(e.sampleRate);
+        clearHistory();
+    }
+
+    // Gathers one frame of comparator input
+    Frame readFrame() {
+        Frame frame;
 
         // Input normalization A -> B -> C -> D
-        float inA = inputs[A_IN_INPUT].getVoltage();
-        float inB = inputs[B_IN_INPUT].isConnected() ? inputs[B_IN_INPUT].getVoltage() : inA;
-        float inC = inputs[C_IN_INPUT].isConnected() ? inputs[C_IN_INPUT].getVoltage() : inB;
-        float inD = inputs[D_IN_INPUT].isConnected() ? inputs[D_IN_INPUT].getVoltage() : inC;
-
-        auto runChannel = [&](float in, int shiftParam, int sizeParam, int shiftCvId, int sizeCvId,
-                              bool& hi, bool& win, bool& lo,
-                              int oHi, int oWin, int oLo,
-                              int lHi, int lWin, int lLo) {
-            float center = params[shiftParam].getValue() + inputs[shiftCvId].getVoltage();
-            float size   = std::max(0.0001f, params[sizeParam].getValue() + inputs[sizeCvId].getVoltage());
-            float hiEdge = center + 0.5f * size;
-            float loEdge = center - 0.5f * size;
-
-            if (in > hiEdge + H) {
-                hi=true; win=false; lo=false;
-            } else if (in < loEdge - H) {
-                hi=false; win=false; lo=true;
+        frame.in[0] = inputs[A_IN_INPUT].getVoltage();
+        for (int c = 1; c < 4; c++) {
+            int inId = A_IN_INPUT + 3 * c;
+            frame.in[c] = inputs[inId].isConnected() ? inputs[inId].getVoltage() : frame.in[c - 1];
+        }
+
+        frame.shiftCv = readShiftCvs();
+        frame.sizeCv = readSizeCvs();
+        frame.reset = expansionInputs[Expander::RESET_INPUT].getVoltage();
+        frame.morph = expansionInputs[Expander::MORPH_INPUT].isConnected()
+            ? expansionInputs[Expander::MORPH_INPUT].getVoltage() : NAN;
+        return frame;
+    }
+
+    simd::float_4 readShiftCvs() {
+        return simd::float_4(inputs[A_SHIFT_CV_INPUT].getVoltage(), inputs[B_SHIFT_CV_INPUT].getVoltage(),
+                             inputs[C_SHIFT_CV_INPUT].getVoltage(), inputs[D_SHIFT_CV_INPUT].getVoltage());
+    }
+
+    simd::float_4 readSizeCvs() {
+        return simd::float_4(inputs[A_SIZE_CV_INPUT].getVoltage(), inputs[B_SIZE_CV_INPUT].getVoltage(),
+                             inputs[C_SIZE_CV_INPUT].getVoltage(), inputs[D_SIZE_CV_INPUT].getVoltage());
+    }
+
+    // Comparator kernel: advances kernelState over `n` consecutive frames and
+    // writes the packed state word of each into `states`. Both arrays are
+    // time-major; each pass is a straight loop over time so the stateless
+    // parts vectorize across samples as well as across the four channels.
+    void processFrames(const Frame* frames, uint32_t* states, int n) {
+        // Window settings: the knobs, or the snapshot morph when MORPH is
+        // patched, at the block's latest MORPH reading
+        simd::float_4 shiftKnob;
+        simd::float_4 sizeKnob;
+        float H;    // hysteresis in volts
+        float morph = frames[n - 1].morph;
+        if (morphTable && morphTable->count > 0 && !std::isnan(morph)) {
+            updateMorph(morph);
+            shiftKnob = morphShift;
+            sizeKnob = morphSize;
+            H = morphHysteresis;
+        }
+        else {
+            shiftKnob = simd::float_4(params[A_SHIFT_PARAM].getValue(), params[B_SHIFT_PARAM].getValue(),
+                                      params[C_SHIFT_PARAM].getValue(), params[D_SHIFT_PARAM].getValue());
+            sizeKnob = simd::float_4(params[A_SIZE_PARAM].getValue(), params[B_SIZE_PARAM].getValue(),
+                                     params[C_SIZE_PARAM].getValue(), params[D_SIZE_PARAM].getValue());
+            H = params[HYSTERESIS_PARAM].getValue();
+        }
+
+        // Pass 1: input conditioning. The sliding median (if any) removes
+        // glitches, then the envelope detector: each lane rectifies (|x|,
+        // x^2 or level in V/10 dB re 5 V, or its spectral band level) and
+        // follows it with attack/release one-poles. Lanes with both off
+        // compare the raw input.
+        simd::float_4 levels[MAX_BLOCK_SIZE];
+        if (median.active) {
+            for (int t = 0; t < n; t++) {
+                levels[t] = median.process(frames[t].in);
+            }
+        } else {
+            for (int t = 0; t < n; t++) {
+                levels[t] = frames[t].in;
+            }
+        }
+        if (detectorActive) {
+            for (int t = 0; t < n; t++) {
+                simd::float_4 in = levels[t];
+                if (detectorSpectralActive) {
+                    spectralHistory[spectralPos] = in[0];
+                    spectralPos = (spectralPos + 1) & (SPECTRAL_SIZE - 1);
+                    if (++spectralHopCount >= SPECTRAL_HOP) {
+                        spectralHopCount = 0;
+                        updateSpectrum();
+                    }
+                }
+                simd::float_4 rect = simd::ifelse(detectorRms, in * in, simd::fabs(in));
+                if (detectorLogActive) {
+                    // 20 log10(|x| / 5) / 10, floored at -100 dB
+                    simd::float_4 db = 2.f * simd::log10(simd::fmax(simd::fabs(in), 5e-5f) * 0.2f);
+                    rect = simd::ifelse(detectorLog, db, rect);
+                }
+                rect = simd::ifelse(detectorSpectral, spectralLevel, rect);
+                simd::float_4 coef = simd::ifelse(rect > detectorEnv, detectorAttackCoef, detectorReleaseCoef);
+                detectorEnv += (rect - detectorEnv) * coef;
+                simd::float_4 level = simd::ifelse(detectorRms, simd::sqrt(detectorEnv), detectorEnv);
+                levels[t] = simd::ifelse(detectorOn, level, in);
+            }
+        }
+
+        // Pass 2: window edges. SHIFT/SIZE CVs are smoothed as two float_4
+        // one-poles when any slew is set; otherwise each sample is independent.
+        // At control rate only the divider ticks compute edges; the samples
+        // in between add one step to each edge.
+        simd::float_4 hiEdges[MAX_BLOCK_SIZE];
+        simd::float_4 loEdges[MAX_BLOCK_SIZE];
+        if (cvDivider > 1) {
+            for (int t = 0; t < n; t++) {
+                if (--cvCounter <= 0) {
+                    cvCounter = cvDivider;
+                    if (slewActive) {
+                        shiftCvSmooth += (frames[t].shiftCv - shiftCvSmooth) * slewCoefDivided;
+                        sizeCvSmooth += (frames[t].sizeCv - sizeCvSmooth) * slewCoefDivided;
+                    } else {
+                        shiftCvSmooth = frames[t].shiftCv;
+                        sizeCvSmooth = frames[t].sizeCv;
+                    }
+                    simd::float_4 center = shiftKnob + shiftCvSmooth;
+                    simd::float_4 size   = simd::fmax(0.0001f, sizeKnob + sizeCvSmooth);
+                    if (!cvEdgesValid) {
+                        // Nothing to ramp from: start at the first edges
+                        cvHiEdge = center + 0.5f * size;
+                        cvLoEdge = center - 0.5f * size;
+                        cvEdgesValid = true;
+                    }
+                    float ramp = 1.f / cvDivider;
+                    cvHiStep = (center + 0.5f * size - cvHiEdge) * ramp;
+                    cvLoStep = (center - 0.5f * size - cvLoEdge) * ramp;
+                }
+                cvHiEdge += cvHiStep;
+                cvLoEdge += cvLoStep;
+                hiEdges[t] = cvHiEdge;
+                loEdges[t] = cvLoEdge;
+            }
+        } else {
+            if (slewActive) {
+                for (int t = 0; t < n; t++) {
+                    shiftCvSmooth += (frames[t].shiftCv - shiftCvSmooth) * slewCoef;
+                    sizeCvSmooth += (frames[t].sizeCv - sizeCvSmooth) * slewCoef;
+                    simd::float_4 center = shiftKnob + shiftCvSmooth;
+                    simd::float_4 size   = simd::fmax(0.0001f, sizeKnob + sizeCvSmooth);
+                    hiEdges[t] = center + 0.5f * size;
+                    loEdges[t] = center - 0.5f * size;
+                }
             } else {
-                // inside the extended band; settle toward WIN
-                if ((hi && in <= hiEdge - H) || (lo && in >= loEdge + H) || (!win && in >= loEdge + H && in <= hiEdge - H)) {
-                    hi=false; win=true; lo=false;
+                for (int t = 0; t < n; t++) {
+                    simd::float_4 center = shiftKnob + frames[t].shiftCv;
+                    simd::float_4 size   = simd::fmax(0.0001f, sizeKnob + frames[t].sizeCv);
+                    hiEdges[t] = center + 0.5f * size;
+                    loEdges[t] = center - 0.5f * size;
                 }
+                shiftCvSmooth = frames[n - 1].shiftCv;
+                sizeCvSmooth = frames[n - 1].sizeCv;
             }
+            // Kept current so switching to a divider ramps from here
+            cvHiEdge = hiEdges[n - 1];
+            cvLoEdge = loEdges[n - 1];
+            cvEdgesValid = true;
+        }
+
+        // Relative channels move both edges by their source's level
+        if (relativeActive) {
+            for (int t = 0; t < n; t++) {
+                simd::float_4 in = levels[t];
+                simd::float_4 reference = relativeWeights[0] * in[0] + relativeWeights[1] * in[1]
+                                        + relativeWeights[2] * in[2] + relativeWeights[3] * in[3];
+                hiEdges[t] += reference;
+                loEdges[t] += reference;
+            }
+        }
+
+        // Feed the analysis the level actually compared against the knob
+        // window: conditioned, and relative to its source. A full queue
+        // just drops the sample.
+        if (learnInputs.load(std::memory_order_relaxed)) {
+            for (int t = 0; t < n; t++) {
+                if (++analysisCounter < AnalysisFeed::DECIMATION)
+                    continue;
+                analysisCounter = 0;
+                simd::float_4 in = levels[t];
+                if (relativeActive) {
+                    in -= relativeWeights[0] * in[0] + relativeWeights[1] * in[1]
+                        + relativeWeights[2] * in[2] + relativeWeights[3] * in[3];
+                }
+                analysisFeed.samples.push(in);
+            }
+        }
+
+        // Hysteresis per sample. Adaptive lanes update the noise estimate
+        // for all four channels at once and replace the fixed value.
+        simd::float_4 hysteresis[MAX_BLOCK_SIZE];
+        uint32_t adaptiveOn = adaptiveBits.load(std::memory_order_relaxed);
+        if (adaptiveOn) {
+            simd::float_4 adaptive = bitsToLanes(adaptiveOn) > 0.f;
+            float multiplier = params[ADAPTIVE_HYSTERESIS_PARAM].getValue();
+            for (int t = 0; t < n; t++) {
+                simd::float_4 diff = levels[t] - noisePrev;
+                noisePrev = levels[t];
+                noiseMean += (diff - noiseMean) * noiseCoef;
+                noiseSquare += (diff * diff - noiseSquare) * noiseCoef;
+                simd::float_4 deviation = simd::sqrt(simd::fmax(noiseSquare - noiseMean * noiseMean, 0.f));
+                simd::float_4 bounded = simd::fmin(simd::fmax(deviation * multiplier, ADAPTIVE_MIN), ADAPTIVE_MAX);
+                hysteresis[t] = simd::ifelse(adaptive, bounded, H);
+            }
+        } else {
+            for (int t = 0; t < n; t++) {
+                hysteresis[t] = H;
+            }
+            noisePrev = levels[n - 1];
+        }
+
+        // Pass 3: hysteresis comparator, branch-free across the four channels.
+        // Pitch-mode channels then gate WIN with their latched scale match.
+        uint32_t pitchOn = pitchOnBits.load(std::memory_order_relaxed);
+        uint32_t pitchMatch = pitchMatchBits;
+        simd::float_4 hi  = bitsToLanes(kernelState >> HI_BIT) > 0.f;
+        simd::float_4 win = bitsToLanes(rawWinBits) > 0.f;
+        simd::float_4 lo  = bitsToLanes(kernelState >> LO_BIT) > 0.f;
+        for (int t = 0; t < n; t++) {
+            simd::float_4 in = levels[t];
+            simd::float_4 above = in > hiEdges[t] + hysteresis[t];
+            simd::float_4 below = in < loEdges[t] - hysteresis[t];
+            simd::float_4 insideHi = in <= hiEdges[t] - hysteresis[t];
+            simd::float_4 insideLo = in >= loEdges[t] + hysteresis[t];
+
+            // inside the extended band; settle toward WIN, otherwise hold
+            simd::float_4 settle = (hi & insideHi) | (lo & insideLo) | (~win & insideLo & insideHi);
+            simd::float_4 hold = ~(above | below | settle);
+            hi  = above | (hold & hi);
+            lo  = (below & ~above) | (hold & lo);
+            win = ~(above | below) & (settle | win);
+
+            uint32_t winBits = simd::movemask(win);
+            if (pitchOn && pitchTables) {
+                simd::float_4 cents = in * (float) CENTS_PER_OCTAVE;
+                cents -= CENTS_PER_OCTAVE * simd::floor(cents * (1.f / CENTS_PER_OCTAVE));
+                // NaN and infinite inputs, and rounding at huge ones, land
+                // outside [0, 1200); read those as C rather than cast them
+                cents = simd::ifelse((cents >= 0.f) & (cents < (float) CENTS_PER_OCTAVE), cents, 0.f);
+                for (int c = 0; c < 4; c++) {
+                    if (!((pitchOn >> c) & 1))
+                        continue;
+                    uint8_t entry = pitchTables->entries[c][(int) cents[c]];
+                    if (entry & PITCH_INNER)
+                        pitchMatch |= 1u << c;
+                    else if (!(entry & PITCH_OUTER))
+                        pitchMatch &= ~(1u << c);
+                }
+                winBits &= pitchMatch | ~pitchOn;
+            }
+
+            states[t] = (uint32_t) simd::movemask(hi) << HI_BIT
+                      | winBits << WIN_BIT
+                      | (uint32_t) simd::movemask(lo) << LO_BIT;
+        }
+        rawWinBits = simd::movemask(win);
+        pitchMatchBits = pitchMatch;
+
+        // Pass 4: pair logic on the packed words. Only the flip-flops carry
+        // state from one sample to the next.
+        uint32_t prev = kernelState;
+        for (int t = 0; t < n; t++) {
+            uint32_t next = states[t];
+            uint32_t w = next >> WIN_BIT;
+
+            uint32_t abAnd = w & (w >> 1) & 1;
+            uint32_t abOr  = (w | (w >> 1)) & 1;
+            uint32_t abXor = (w ^ (w >> 1)) & 1;
+            uint32_t cdAnd = (w >> 2) & (w >> 3) & 1;
+            uint32_t cdOr  = ((w >> 2) | (w >> 3)) & 1;
+            uint32_t cdXor = ((w >> 2) ^ (w >> 3)) & 1;
+
+            // Flip-flops toggle on XOR rising edges
+            uint32_t abFlipFlop = ((prev >> AB_FF_BIT) ^ (abXor & ~(prev >> AB_XOR_BIT))) & 1;
+            uint32_t cdFlipFlop = ((prev >> CD_FF_BIT) ^ (cdXor & ~(prev >> CD_XOR_BIT))) & 1;
+
+            // A pair is active when any of its AND/OR/XOR is, i.e. its OR
+            uint32_t abActive = abOr;
+            uint32_t cdActive = cdOr;
+
+            next |= abAnd << AB_AND_BIT;
+            next |= abOr << AB_OR_BIT;
+            next |= abXor << AB_XOR_BIT;
+            next |= abFlipFlop << AB_FF_BIT;
+            next |= cdAnd << CD_AND_BIT;
+            next |= cdOr << CD_OR_BIT;
+            next |= cdXor << CD_XOR_BIT;
+            next |= cdFlipFlop << CD_FF_BIT;
+            next |= (abActive & cdActive) << PAIRS_AND_BIT;
+            next |= (abActive | cdActive) << PAIRS_OR_BIT;
+            next |= (abActive ^ cdActive) << PAIRS_XOR_BIT;
+
+            states[t] = next;
+            prev = next;
+        }
+        kernelState = prev;
+    }
+
+    // Output stage for one sample: drives every jack and LED from the packed
+    // state word `next`, diffing it against the previously emitted word.
+    // `frame` is the input frame `next` was computed from.
+    void renderFrame(const Frame& frame, uint32_t next, const ProcessArgs& args) {
+        // Dwell counters restart whenever a channel's HI/WIN/LO changes
+        uint32_t changed = state ^ next;
+        uint32_t crossed = (changed | (changed >> WIN_BIT) | (changed >> LO_BIT)) & 0xf;
+        for (int c = 0; c < 4; c++) {
+            if ((crossed >> c) & 1) {
+                dwellSamples[c] = 0;
+            } else if (dwellSamples[c] < UINT32_MAX) {
+                dwellSamples[c]++;
+            }
+        }
+
+        // Rolling WIN duty cycle and crossing rate
+        winDuty += (bitsToLanes(next >> WIN_BIT) - winDuty) * measureCoef;
+        crossRate += (bitsToLanes(crossed) * args.sampleRate - crossRate) * measureCoef;
+
+        // Sample & hold, latched branch-free from the per-channel edge nibble
+        uint32_t enters = ((changed & next) >> WIN_BIT) & 0xf;
+        uint32_t exits = (changed & ~next) >> WIN_BIT;
+        uint32_t latchBits = shLatchBits.load(std::memory_order_relaxed);
+        uint32_t latch = (enters & latchBits & 0xf) | (exits & (latchBits >> 4) & 0xf) | (crossed & (latchBits >> 8));
+        sampleHeld = simd::ifelse(bitsToLanes(latch) > 0.f, frame.in, sampleHeld);
+        expansionOutputs[Expander::SH_OUTPUT].setChannels(4);
+        expansionOutputs[Expander::SH_OUTPUT].setVoltageSimd(sampleHeld, 0);
+
+        // WIN-entry counters: integer work only on the entering channels
+        if (resetTrigger.process(frame.reset, 0.1f, 1.f)) {
+            for (int c = 0; c < 4; c++) {
+                entryCounts[c] = 0;
+            }
+            selectedBits = 0;
+        }
+        for (uint32_t e = enters; e; e &= e - 1) {
+            int c = __builtin_ctz(e);
+            uint32_t division = (uint32_t) params[A_DIVISION_PARAM + c].getValue();
+            uint32_t count = entryCounts[c] % division;
+            selectedBits = (count == 0) ? (selectedBits | (1u << c)) : (selectedBits & ~(1u << c));
+            entryCounts[c] = (count + 1 == division) ? 0 : count + 1;
+        }
+        if (expansionOutputs[Expander::DIV_OUTPUT].isConnected() || expansionOutputs[Expander::COUNT_OUTPUT].isConnected()) {
+            simd::float_4 divisions(params[A_DIVISION_PARAM].getValue(), params[B_DIVISION_PARAM].getValue(),
+                                    params[C_DIVISION_PARAM].getValue(), params[D_DIVISION_PARAM].getValue());
+            simd::float_4 counts((float) entryCounts[0], (float) entryCounts[1],
+                                 (float) entryCounts[2], (float) entryCounts[3]);
+            expansionOutputs[Expander::DIV_OUTPUT].setChannels(4);
+            simd::float_4 divided = bitsToLanes((next >> WIN_BIT) & selectedBits);
+            expansionOutputs[Expander::DIV_OUTPUT].setVoltageSimd(outputLow[GROUP_EXPANSION] + divided * outputSpan[GROUP_EXPANSION], 0);
+            expansionOutputs[Expander::COUNT_OUTPUT].setChannels(4);
+            expansionOutputs[Expander::COUNT_OUTPUT].setVoltageSimd(simd::fmin(counts / divisions, 1.f) * 10.f, 0);
+        }
+
+        // Pass-through: all four channels in one float_4 multiply
+        simd::float_4 winLanes = bitsToLanes(next >> WIN_BIT);
+        if (expansionOutputs[Expander::PASS_OUTPUT].isConnected()) {
+            passGain += (winLanes - passGain) * passCoef;
+            expansionOutputs[Expander::PASS_OUTPUT].setChannels(4);
+            expansionOutputs[Expander::PASS_OUTPUT].setVoltageSimd(frame.in * passGain, 0);
+        } else {
+            passGain = winLanes;
+        }
+
+        // Edge triggers: changed bits of the packed word start a 1 ms countdown
+        bool channelTriggers = expansionOutputs[Expander::RISE_OUTPUT].isConnected() || expansionOutputs[Expander::FALL_OUTPUT].isConnected();
+        bool logicTriggers = expansionOutputs[Expander::LOGIC_RISE_OUTPUT].isConnected() || expansionOutputs[Expander::LOGIC_FALL_OUTPUT].isConnected();
+        // Unpatched groups stop counting down: clear them so a re-patched
+        // output does not fire a stale pulse
+        for (int g = 0; g < NUM_TRIGGER_GROUPS; g++) {
+            if (!((g < 3) ? channelTriggers : logicTriggers)) {
+                riseTimers[g] = 0.f;
+                fallTimers[g] = 0.f;
+            }
+        }
+        if (channelTriggers || logicTriggers) {
+            uint32_t rises = changed & next;
+            uint32_t falls = changed & ~next;
+            int firstGroup = channelTriggers ? 0 : 3;
+            int lastGroup = logicTriggers ? NUM_TRIGGER_GROUPS : 3;
+            for (int g = firstGroup; g < lastGroup; g++) {
+                simd::float_4 riseMask = bitsToLanes(rises >> (4 * g)) > 0.f;
+                simd::float_4 fallMask = bitsToLanes(falls >> (4 * g)) > 0.f;
+                riseTimers[g] = simd::ifelse(riseMask, 1e-3f, riseTimers[g] - args.sampleTime);
+                fallTimers[g] = simd::ifelse(fallMask, 1e-3f, fallTimers[g] - args.sampleTime);
+            }
+
+            expansionOutputs[Expander::RISE_OUTPUT].setChannels(12);
+            expansionOutputs[Expander::FALL_OUTPUT].setChannels(12);
+            expansionOutputs[Expander::LOGIC_RISE_OUTPUT].setChannels(NUM_STATE_BITS - 12);
+            expansionOutputs[Expander::LOGIC_FALL_OUTPUT].setChannels(NUM_STATE_BITS - 12);
+            for (int g = 0; g < NUM_TRIGGER_GROUPS; g++) {
+                int outputOffset = (g < 3) ? 0 : 2;
+                int firstChannel = 4 * (g % 3);
+                simd::float_4 high = outputHigh[GROUP_EXPANSION];
+                simd::float_4 low = outputLow[GROUP_EXPANSION];
+                expansionOutputs[Expander::RISE_OUTPUT + outputOffset].setVoltageSimd(simd::ifelse(riseTimers[g] > 0.f, high, low), firstChannel);
+                expansionOutputs[Expander::FALL_OUTPUT + outputOffset].setVoltageSimd(simd::ifelse(fallTimers[g] > 0.f, high, low), firstChannel);
+            }
+        }
 
-            outputs[oHi].setVoltage(hi ? 10.f : 0.f);
-            outputs[oWin].setVoltage(win ? 10.f : 0.f);
-            outputs[oLo].setVoltage(lo ? 10.f : 0.f);
+        // Pattern matcher: fed the gate edges, a few bit ops per changed gate
+        if (pattern && pattern->length > 0) {
+            if (patternMatcher.process(changed & next, changed & ~next)) {
+                matchTimer = 1e-3f;
+                matchGate = true;
+            }
+            if ((((next >> pattern->lastGate) & 1) != 0) != pattern->lastRising)
+                matchGate = false;
+            matchTimer -= args.sampleTime;
+            bool high = (matchMode == MATCH_GATE) ? matchGate : (matchTimer > 0.f);
+            expansionOutputs[Expander::MATCH_OUTPUT].setVoltage(high ? outputHighLevels[GROUP_EXPANSION] : outputLowLevels[GROUP_EXPANSION]);
+        } else {
+            expansionOutputs[Expander::MATCH_OUTPUT].setVoltage(outputLowLevels[GROUP_EXPANSION]);
+        }
+
+        state = next;
+
+        // State bus: a slot is cleared when its last publisher moves away
+        if (busPublishSlot != busPublishedSlot) {
+            if (busPublishedSlot >= 0)
+                busLeave(busPublishedSlot);
+            busPublishedSlot = busPublishSlot;
+            if (busPublishedSlot >= 0)
+                busJoin(busPublishedSlot);
+        }
+        if (busPublishedSlot >= 0)
+            busPublish(busPublishedSlot, args.frame, state);
+        if (expansionOutputs[Expander::BUS_OUTPUT].isConnected()) {
+            uint32_t local = state >> WIN_BIT;
+            uint32_t remote = (busListenSlot >= 0) ? busRead(busListenSlot, args.frame) >> WIN_BIT : 0;
+            expansionOutputs[Expander::BUS_OUTPUT].setChannels(12);
+            simd::float_4 low = outputLow[GROUP_EXPANSION];
+            simd::float_4 span = outputSpan[GROUP_EXPANSION];
+            expansionOutputs[Expander::BUS_OUTPUT].setVoltageSimd(low + bitsToLanes(local & remote) * span, 0);
+            expansionOutputs[Expander::BUS_OUTPUT].setVoltageSimd(low + bitsToLanes(local | remote) * span, 4);
+            expansionOutputs[Expander::BUS_OUTPUT].setVoltageSimd(low + bitsToLanes(local ^ remote) * span, 8);
+        }
+
+        // Delayed taps read back from the packed history
+        pushHistory();
+        if (expansionOutputs[Expander::DELAY_OUTPUT].isConnected())
+            renderDelayTap(Expander::DELAY_OUTPUT, 0, 12, params[DELAY_PARAM].getValue(), args.sampleRate);
+        if (expansionOutputs[Expander::LOGIC_DELAY_OUTPUT].isConnected())
+            renderDelayTap(Expander::LOGIC_DELAY_OUTPUT, AB_AND_BIT, NUM_STATE_BITS - AB_AND_BIT, params[LOGIC_DELAY_PARAM].getValue(), args.sampleRate);
+
+        // Gates and LEDs, four state bits at a time. The HI/WIN/LO groups
+        // take the shaped ramps when an output shape is on.
+        for (int g = 0; g * 4 < NUM_STATE_BITS; g++) {
+            simd::float_4 level = bitsToLanes(state >> (4 * g));
+            simd::float_4 gates = level;
+            if (g < 3 && activeOutputShape != SHAPE_OFF) {
+                if (activeOutputShape == SHAPE_EXPONENTIAL)
+                    outputRamps[g] += (level - outputRamps[g]) * outputCoef;
+                else
+                    outputRamps[g] += simd::fmin(simd::fmax(level - outputRamps[g], -outputStep), outputStep);
+                level = outputRamps[g];
+                if (activeOutputShape == SHAPE_COSINE)
+                    level = 0.5f - 0.5f * simd::cos(float(M_PI) * level);
+            }
+            int group = (g < 3) ? GROUP_CHANNELS : GROUP_LOGIC;
+            simd::float_4 voltage = outputLow[group] + level * outputSpan[group];
+            for (int c = 0; c < 4 && 4 * g + c < NUM_STATE_BITS; c++) {
+                int id = stateOutputId(4 * g + c);
+                outputs[id].setVoltage(voltage[c]);
+                lights[id].setBrightnessSmooth(gates[c], args.sampleTime);
+            }
+        }
+
+        // Measurements
+        simd::float_4 dwell((float) dwellSamples[0], (float) dwellSamples[1],
+                            (float) dwellSamples[2], (float) dwellSamples[3]);
+        expansionOutputs[Expander::DWELL_OUTPUT].setChannels(4);
+        expansionOutputs[Expander::DWELL_OUTPUT].setVoltageSimd(simd::fmin(dwell * args.sampleTime, 10.f), 0);
+        expansionOutputs[Expander::DUTY_OUTPUT].setChannels(4);
+        expansionOutputs[Expander::DUTY_OUTPUT].setVoltageSimd(winDuty * 10.f, 0);
+        expansionOutputs[Expander::RATE_OUTPUT].setChannels(4);
+        expansionOutputs[Expander::RATE_OUTPUT].setVoltageSimd(simd::fmin(crossRate * 0.1f, 10.f), 0);
+    }
 
-            lights[lHi].setBrightnessSmooth(hi ? 1.f : 0.f, args.sampleTime);
-            lights[lWin].setBrightnessSmooth(win ? 1.f : 0.f, args.sampleTime);
-            lights[lLo].setBrightnessSmooth(lo ? 1.f : 0.f, args.sampleTime);
-        };
+    // Output latency in samples introduced by block mode
+    int getLatency() const {
+        return (activeBlockSize > 1) ? activeBlockSize : 0;
+    }
 
-        runChannel(inA, A_SHIFT_PARAM, A_SIZE_PARAM, A_SHIFT_CV_INPUT, A_SIZE_CV_INPUT,
-                   aHi, aWin, aLo, A_HI_OUTPUT, A_WIN_OUTPUT, A_LO_OUTPUT, A_HI_LIGHT, A_WIN_LIGHT, A_LO_LIGHT);
-        runChannel(inB, B_SHIFT_PARAM, B_SIZE_PARAM, B_SHIFT_CV_INPUT, B_SIZE_CV_INPUT,
-                   bHi, bWin, bLo, B_HI_OUTPUT, B_WIN_OUTPUT, B_LO_OUTPUT, B_HI_LIGHT, B_WIN_LIGHT, B_LO_LIGHT);
-        runChannel(inC, C_SHIFT_PARAM, C_SIZE_PARAM, C_SHIFT_CV_INPUT, C_SIZE_CV_INPUT,
-                   cHi, cWin, cLo, C_HI_OUTPUT, C_WIN_OUTPUT, C_LO_OUTPUT, C_HI_LIGHT, C_WIN_LIGHT, C_LO_LIGHT);
-        runChannel(inD, D_SHIFT_PARAM, D_SIZE_PARAM, D_SHIFT_CV_INPUT, D_SIZE_CV_INPUT,
-                   dHi, dWin, dLo, D_HI_OUTPUT, D_WIN_OUTPUT, D_LO_OUTPUT, D_HI_LIGHT, D_WIN_LIGHT, D_LO_LIGHT);
+    // Applies changed settings and takes the tables handed over by the UI
+    // thread. Called once per block, which is every sample without blocks.
+    void pollSettings(const ProcessArgs& args) {
+        updateSlew(args.sampleRate);
+        updateMedian();
+        updateDetectorModes();
+        updateDetector(args.sampleRate);
+        updateRelative();
+        if (detectorSpectralActive)
+            updateSpectralBands(args.sampleRate);
+        updateMeasure(args.sampleRate);
+        updateNoise(args.sampleRate);
+        updateOutputShape(args.sampleRate);
+        updateOutputLevels();
+        updatePassRamp(args.sampleRate);
+
+        if (PatternProgram* next = patternHandoff.take()) {
+            patternHandoff.retire(pattern);
+            pattern = next;
+            patternMatcher.setProgram(pattern, args.sampleRate);
+        }
+
+        if (PitchTables* next = pitchTablesHandoff.take()) {
+            pitchTablesHandoff.retire(pitchTables);
+            pitchTables = next;
+        }
+
+        if (SnapshotTable* next = snapshotHandoff.take()) {
+            snapshotHandoff.retire(morphTable);
+            morphTable = next;
+            morphPosition = -1.f;
+        }
+
+        if (InputReplay* next = replayHandoff.take()) {
+            replayHandoff.retire(replay);
+            replay = next;
+        }
+    }
 
-        // Pair logic
-        bool abAnd = aWin && bWin;
-        bool abOr  = aWin || bWin;
-        bool abXor = aWin != bWin;
+    void process(const ProcessArgs& args) override {
+        receiveExpander();
+        // Between blocks only: a block is processed with one set of settings
+        if (blockPos == 0 || blockSize != activeBlockSize)
+            pollSettings(args);
+
+        Frame frame;
+        if (replay && replay->numFrames > 0) {
+            const float* values = replay->next();
+            frame.in = simd::float_4::load(values);
+            frame.shiftCv = simd::float_4::load(values + 4);
+            frame.sizeCv = simd::float_4::load(values + 8);
+            bool v1 = replay->numChannels == RECORDING_CHANNELS_V1;
+            frame.reset = v1 ? 0.f : values[12];
+            frame.morph = v1 ? NAN : values[13];
+        }
+        else {
+            frame = readFrame();
+        }
+
+        // Record the frame exactly as the kernel sees it
+        if (recordTarget.load(std::memory_order_relaxed)) {
+            recordPushing.store(true);
+            if (InputRecorder* target = recordTarget.load()) {
+                RecordingFrame recorded;
+                frame.in.store(recorded.values);
+                frame.shiftCv.store(recorded.values + 4);
+                frame.sizeCv.store(recorded.values + 8);
+                recorded.values[12] = frame.reset;
+                recorded.values[13] = frame.morph;
+                target->push(recorded);
+            }
+            recordPushing.store(false);
+        }
+
+        if (blockSize != activeBlockSize) {
+            // Flush what the old block size still holds, all within this
+            // sample: the rest of the block being emitted, then the partly
+            // collected one. Every input frame reaches the kernel and every
+            // transition reaches the triggers, counters and measurements.
+            if (activeBlockSize > 1) {
+                for (int t = blockPos; t < activeBlockSize; t++) {
+                    renderFrame(blockFrames[blockBuffer ^ 1][t], blockStates[blockBuffer ^ 1][t], args);
+                }
+                if (blockPos > 0) {
+                    processFrames(blockFrames[blockBuffer], blockStates[blockBuffer], blockPos);
+                    for (int t = 0; t < blockPos; t++) {
+                        renderFrame(blockFrames[blockBuffer][t], blockStates[blockBuffer][t], args);
+                    }
+                }
+            }
 
-        outputs[AB_AND_OUTPUT].setVoltage(abAnd ? 10.f : 0.f);
-        outputs[AB_OR_OUTPUT].setVoltage(abOr ? 10.f : 0.f);
-        outputs[AB_XOR_OUTPUT].setVoltage(abXor ? 10.f : 0.f);
+            // Restart block buffering; hold the current state until the
+            // first block has been processed
+            activeBlockSize = blockSize;
+            blockPos = 0;
+            for (int t = 0; t < MAX_BLOCK_SIZE; t++) {
+                blockFrames[blockBuffer ^ 1][t] = frame;
+                blockStates[blockBuffer ^ 1][t] = kernelState;
+            }
+        }
+
+        if (activeBlockSize <= 1) {
+            uint32_t next;
+            processFrames(&frame, &next, 1);
+            renderFrame(frame, next, args);
+        }
+        else {
+            // Block mode: collect this block while emitting the previous one,
+            // which delays every output by exactly activeBlockSize samples
+            blockFrames[blockBuffer][blockPos] = frame;
+            renderFrame(blockFrames[blockBuffer ^ 1][blockPos], blockStates[blockBuffer ^ 1][blockPos], args);
+            if (++blockPos >= activeBlockSize) {
+                processFrames(blockFrames[blockBuffer], blockStates[blockBuffer], activeBlockSize);
+                blockBuffer ^= 1;
+                blockPos = 0;
+            }
+        }
 
-        lights[AB_AND_LIGHT].setBrightnessSmooth(abAnd ? 1.f : 0.f, args.sampleTime);
-        lights[AB_OR_LIGHT].setBrightnessSmooth(abOr ? 1.f : 0.f, args.sampleTime);
-        lights[AB_XOR_LIGHT].setBrightnessSmooth(abXor ? 1.f : 0.f, args.sampleTime);
+        sendExpander();
+    }
 
-        if (abXor && !abXorPrevious) abFlipFlop = !abFlipFlop;
-        abXorPrevious = abXor;
-        outputs[AB_FF_OUTPUT].setVoltage(abFlipFlop ? 10.f : 0.f);
-        lights[AB_FF_LIGHT].setBrightnessSmooth(abFlipFlop ? 1.f : 0.f, args.sampleTime);
+    void onReset(const ResetEvent& e) override {
+        Module::onReset(e);
+        // PITCH HYSTERESIS is back at its default
+        publishPitchTables();
+        kernelState = 0;
+        state = 0;
+        for (int c = 0; c < 4; c++) {
+            dwellSamples[c] = 0;
+        }
+        winDuty = 0.f;
+        crossRate = 0.f;
+        sampleHeld = 0.f;
+        passGain = 0.f;
+        detectorEnv = 0.f;
+        rawWinBits = 0;
+        pitchMatchBits = 0;
+        patternMatcher.reset();
+        matchTimer = 0.f;
+        matchGate = false;
+        for (int c = 0; c < 4; c++) {
+            entryCounts[c] = 0;
+        }
+        selectedBits = 0;
+        noisePrev = 0.f;
+        noiseMean = 0.f;
+        noiseSquare = 0.f;
+    }
 
-        bool cdAnd = cWin && dWin;
-        bool cdOr  = cWin || dWin;
-        bool cdXor = cWin != dWin;
+    void onRandomize(const RandomizeEvent& e) override {
+        Module::onRandomize(e);
+        publishPitchTables();
+    }
 
-        outputs[CD_AND_OUTPUT].setVoltage(cdAnd ? 10.f : 0.f);
-        outputs[CD_OR_OUTPUT].setVoltage(cdOr ? 10.f : 0.f);
-        outputs[CD_XOR_OUTPUT].setVoltage(cdXor ? 10.f : 0.f);
+    // Runtime state is stored as one base64 blob so a loaded, duplicated or
+    // undone module resumes with the same latched gates and flip-flops.
+    json_t* dataToJson() override {
+        json_t* rootJ = json_object();
+
+        StateBlobWriter blob;
+        blob.putU32(STATE_BLOB_VERSION);
+        blob.putU32(kernelState);
+        blob.putFloat4(shiftCvSmooth);
+        blob.putFloat4(sizeCvSmooth);
+        for (int c = 0; c < 4; c++) {
+            blob.putU32(dwellSamples[c]);
+        }
+        blob.putFloat4(winDuty);
+        blob.putFloat4(crossRate);
+        blob.putFloat4(sampleHeld);
+        blob.putFloat4(detectorEnv);
+        blob.putU32(rawWinBits);
+        blob.putU32(pitchMatchBits);
+        for (int c = 0; c < 4; c++) {
+            blob.putU32(entryCounts[c]);
+        }
+        blob.putU32(selectedBits);
+        blob.putFloat4(noisePrev);
+        blob.putFloat4(noiseMean);
+        blob.putFloat4(noiseSquare);
+        json_object_set_new(rootJ, "state", json_string(blob.toBase64().c_str()));
+
+        json_object_set_new(rootJ, "measureWindow", json_integer(measureWindow));
+        json_object_set_new(rootJ, "blockSize", json_integer(blockSize));
+        json_object_set_new(rootJ, "cvDivider", json_integer(cvDivider));
+        json_object_set_new(rootJ, "pattern", json_string(patternText.c_str()));
+        json_object_set_new(rootJ, "matchMode", json_integer(matchMode));
+        json_object_set_new(rootJ, "outputShape", json_integer(outputShape));
+        json_object_set_new(rootJ, "learnInputs", json_boolean(learnInputs.load()));
+
+        json_t* outputInvertedJ = json_array();
+        for (int g = 0; g < NUM_OUTPUT_GROUPS; g++) {
+            json_array_append_new(outputInvertedJ, json_boolean(outputInverted[g]));
+        }
+        json_object_set_new(rootJ, "outputInverted", outputInvertedJ);
+
+        json_object_set_new(rootJ, "busPublish", json_integer(busPublishSlot));
+        json_object_set_new(rootJ, "busListen", json_integer(busListenSlot));
+
+        json_t* sampleHoldModesJ = json_array();
+        for (int c = 0; c < 4; c++) {
+            json_array_append_new(sampleHoldModesJ, json_integer(sampleHoldModes[c]));
+        }
+        json_object_set_new(rootJ, "sampleHoldModes", sampleHoldModesJ);
+
+        json_t* detectorModesJ = json_array();
+        for (int c = 0; c < 4; c++) {
+            json_array_append_new(detectorModesJ, json_integer(detectorModes[c]));
+        }
+        json_object_set_new(rootJ, "detectorModes", detectorModesJ);
+
+        json_t* medianLengthsJ = json_array();
+        for (int c = 0; c < 4; c++) {
+            json_array_append_new(medianLengthsJ, json_integer(medianLengths[c]));
+        }
+        json_object_set_new(rootJ, "medianLengths", medianLengthsJ);
+
+        json_t* relativeSourcesJ = json_array();
+        for (int c = 0; c < 4; c++) {
+            json_array_append_new(relativeSourcesJ, json_integer(relativeSources[c]));
+        }
+        json_object_set_new(rootJ, "relativeSources", relativeSourcesJ);
+
+        json_t* adaptiveModesJ = json_array();
+        for (int c = 0; c < 4; c++) {
+            json_array_append_new(adaptiveModesJ, json_boolean(adaptiveModes[c]));
+        }
+        json_object_set_new(rootJ, "adaptiveHysteresis", adaptiveModesJ);
+
+        json_t* pitchModesJ = json_array();
+        json_t* scaleMasksJ = json_array();
+        for (int c = 0; c < 4; c++) {
+            json_array_append_new(pitchModesJ, json_boolean(pitchModes[c]));
+            json_array_append_new(scaleMasksJ, json_integer(scaleMasks[c]));
+        }
+        json_object_set_new(rootJ, "pitchModes", pitchModesJ);
+        json_object_set_new(rootJ, "scaleMasks", scaleMasksJ);
+
+        // Each snapshot: shift A..D, size A..D, hysteresis
+        json_t* snapshotsJ = json_array();
+        for (int i = 0; i < snapshots.count; i++) {
+            json_t* snapshotJ = json_array();
+            for (int c = 0; c < 4; c++) {
+                json_array_append_new(snapshotJ, json_real(snapshots.shift[i][c]));
+            }
+            for (int c = 0; c < 4; c++) {
+                json_array_append_new(snapshotJ, json_real(snapshots.size[i][c]));
+            }
+            json_array_append_new(snapshotJ, json_real(snapshots.hysteresis[i]));
+            json_array_append_new(snapshotsJ, snapshotJ);
+        }
+        json_object_set_new(rootJ, "snapshots", snapshotsJ);
 
-        lights[CD_AND_LIGHT].setBrightnessSmooth(cdAnd ? 1.f : 0.f, args.sampleTime);
-        lights[CD_OR_LIGHT].setBrightnessSmooth(cdOr ? 1.f : 0.f, args.sampleTime);
-        lights[CD_XOR_LIGHT].setBrightnessSmooth(cdXor ? 1.f : 0.f, args.sampleTime);
+        return rootJ;
+    }
 
-        if (cdXor && !cdXorPrevious) cdFlipFlop = !cdFlipFlop;
-        cdXorPrevious = cdXor;
-        outputs[CD_FF_OUTPUT].setVoltage(cdFlipFlop ? 10.f : 0.f);
-        lights[CD_FF_LIGHT].setBrightnessSmooth(cdFlipFlop ? 1.f : 0.f, args.sampleTime);
+    void dataFromJson(json_t* rootJ) override {
+        json_t* measureWindowJ = json_object_get(rootJ, "measureWindow");
+        if (measureWindowJ)
+            measureWindow = clamp((int) json_integer_value(measureWindowJ), 0, NUM_MEASURE_WINDOWS - 1);
+
+        json_t* blockSizeJ = json_object_get(rootJ, "blockSize");
+        if (blockSizeJ) {
+            int size = json_integer_value(blockSizeJ);
+            blockSize = (size == 8 || size == 16 || size == 32) ? size : 1;
+        }
+
+        json_t* cvDividerJ = json_object_get(rootJ, "cvDivider");
+        if (cvDividerJ) {
+            int divider = json_integer_value(cvDividerJ);
+            cvDivider = (divider == 4 || divider == 8 || divider == 16 || divider == 32) ? divider : 1;
+        }
+
+        json_t* patternJ = json_object_get(rootJ, "pattern");
+        if (patternJ)
+            setPattern(json_string_value(patternJ));
+
+        json_t* matchModeJ = json_object_get(rootJ, "matchMode");
+        if (matchModeJ)
+            matchMode = clamp((int) json_integer_value(matchModeJ), 0, NUM_MATCH_MODES - 1);
+
+        json_t* outputShapeJ = json_object_get(rootJ, "outputShape");
+        if (outputShapeJ)
+            outputShape = clamp((int) json_integer_value(outputShapeJ), 0, NUM_OUTPUT_SHAPES - 1);
+
+        json_t* learnInputsJ = json_object_get(rootJ, "learnInputs");
+        if (learnInputsJ)
+            setLearnInputs(json_boolean_value(learnInputsJ));
+
+        json_t* outputInvertedJ = json_object_get(rootJ, "outputInverted");
+        if (outputInvertedJ) {
+            for (int g = 0; g < NUM_OUTPUT_GROUPS; g++) {
+                json_t* invertedJ = json_array_get(outputInvertedJ, g);
+                if (invertedJ)
+                    outputInverted[g] = json_boolean_value(invertedJ);
+            }
+        }
+
+        json_t* busPublishJ = json_object_get(rootJ, "busPublish");
+        if (busPublishJ)
+            busPublishSlot = clamp((int) json_integer_value(busPublishJ), -1, NUM_BUS_SLOTS - 1);
+
+        json_t* busListenJ = json_object_get(rootJ, "busListen");
+        if (busListenJ)
+            busListenSlot = clamp((int) json_integer_value(busListenJ), -1, NUM_BUS_SLOTS - 1);
+
+        json_t* sampleHoldModesJ = json_object_get(rootJ, "sampleHoldModes");
+        if (sampleHoldModesJ) {
+            for (int c = 0; c < 4; c++) {
+                json_t* modeJ = json_array_get(sampleHoldModesJ, c);
+                if (modeJ)
+                    setSampleHoldMode(c, clamp((int) json_integer_value(modeJ), 0, NUM_SH_MODES - 1));
+            }
+        }
+
+        json_t* detectorModesJ = json_object_get(rootJ, "detectorModes");
+        if (detectorModesJ) {
+            for (int c = 0; c < 4; c++) {
+                json_t* modeJ = json_array_get(detectorModesJ, c);
+                if (modeJ)
+                    setDetectorMode(c, clamp((int) json_integer_value(modeJ), 0, NUM_DETECTOR_MODES - 1));
+            }
+        }
+
+        json_t* medianLengthsJ = json_object_get(rootJ, "medianLengths");
+        if (medianLengthsJ) {
+            for (int c = 0; c < 4; c++) {
+                json_t* lengthJ = json_array_get(medianLengthsJ, c);
+                if (lengthJ)
+                    setMedianLength(c, clamp((int) json_integer_value(lengthJ), 1, MedianFilter::MAX_LENGTH) | 1);
+            }
+        }
+
+        json_t* relativeSourcesJ = json_object_get(rootJ, "relativeSources");
+        if (relativeSourcesJ) {
+            for (int c = 0; c < 4; c++) {
+                json_t* sourceJ = json_array_get(relativeSourcesJ, c);
+                if (sourceJ)
+                    setRelativeSource(c, clamp((int) json_integer_value(sourceJ), -1, 3));
+            }
+        }
+
+        json_t* adaptiveModesJ = json_object_get(rootJ, "adaptiveHysteresis");
+        if (adaptiveModesJ) {
+            for (int c = 0; c < 4; c++) {
+                json_t* modeJ = json_array_get(adaptiveModesJ, c);
+                if (modeJ)
+                    setAdaptiveMode(c, json_boolean_value(modeJ));
+            }
+        }
+
+        json_t* pitchModesJ = json_object_get(rootJ, "pitchModes");
+        if (pitchModesJ) {
+            for (int c = 0; c < 4; c++) {
+                json_t* modeJ = json_array_get(pitchModesJ, c);
+                if (modeJ)
+                    setPitchMode(c, json_boolean_value(modeJ));
+            }
+        }
+
+        json_t* scaleMasksJ = json_object_get(rootJ, "scaleMasks");
+        if (scaleMasksJ) {
+            for (int c = 0; c < 4; c++) {
+                json_t* maskJ = json_array_get(scaleMasksJ, c);
+                if (maskJ)
+                    scaleMasks[c] = json_integer_value(maskJ) & 0xfff;
+            }
+        }
+        // Scales and PITCH HYSTERESIS (restored with the params) may both
+        // have changed
+        publishPitchTables();
+
+        json_t* snapshotsJ = json_object_get(rootJ, "snapshots");
+        if (snapshotsJ) {
+            snapshots.count = std::min<int>(json_array_size(snapshotsJ), int(MAX_SNAPSHOTS));
+            for (int i = 0; i < snapshots.count; i++) {
+                json_t* snapshotJ = json_array_get(snapshotsJ, i);
+                for (int c = 0; c < 4; c++) {
+                    snapshots.shift[i][c] = json_number_value(json_array_get(snapshotJ, c));
+                    snapshots.size[i][c] = json_number_value(json_array_get(snapshotJ, 4 + c));
+                }
+                snapshots.hysteresis[i] = json_number_value(json_array_get(snapshotJ, 8));
+            }
+            publishSnapshots();
+        }
+
+        json_t* stateJ = json_object_get(rootJ, "state");
+        if (!stateJ)
+            return;
+
+        StateBlobReader blob(json_string_value(stateJ));
+        uint32_t version;
+        if (!blob.getU32(version) || version < 1)
+            return;
+        // A blob from a newer build carries extra fields after ours; they
+        // are simply not read
+        blob.getU32(kernelState);
+        state = kernelState;
+        rawWinBits = (kernelState >> WIN_BIT) & 0xf;
+        if (version < 2)
+            return;
+        blob.getFloat4(shiftCvSmooth);
+        blob.getFloat4(sizeCvSmooth);
+        if (version < 3)
+            return;
+        for (int c = 0; c < 4; c++) {
+            blob.getU32(dwellSamples[c]);
+        }
+        blob.getFloat4(winDuty);
+        blob.getFloat4(crossRate);
+        if (version < 4)
+            return;
+        blob.getFloat4(sampleHeld);
+        if (version < 5)
+            return;
+        blob.getFloat4(detectorEnv);
+        if (version < 6)
+            return;
+        blob.getU32(rawWinBits);
+        blob.getU32(pitchMatchBits);
+        if (version < 7)
+            return;
+        for (int c = 0; c < 4; c++) {
+            blob.getU32(entryCounts[c]);
+        }
+        blob.getU32(selectedBits);
+        if (version < 8)
+            return;
+        blob.getFloat4(noisePrev);
+        blob.getFloat4(noiseMean);
+        blob.getFloat4(noiseSquare);
+    }
+};
 
-        bool abActive = abAnd || abOr || abXor;
-        bool cdActive = cdAnd || cdOr || cdXor;
+// Context-menu text field that compiles the pattern on Enter
+struct PatternField : ui::TextField {
+    Comparally* module;
 
-        bool pairsAnd = abActive && cdActive;
-        bool pairsOr  = abActive || cdActive;
-        bool pairsXor = abActive != cdActive;
+    PatternField(Comparally* module) : module(module) {
+        box.size.x = 250.f;
+        placeholder = "+A_WIN +B_HI/50 -C_LO";
+        setText(module->patternText);
+        selectAll();
+    }
 
-        outputs[PAIRS_AND_OUTPUT].setVoltage(pairsAnd ? 10.f : 0.f);
-        outputs[PAIRS_OR_OUTPUT].setVoltage(pairsOr ? 10.f : 0.f);
-        outputs[PAIRS_XOR_OUTPUT].setVoltage(pairsXor ? 10.f : 0.f);
+    void onSelectKey(const SelectKeyEvent& e) override {
+        if (e.action == GLFW_PRESS && (e.key == GLFW_KEY_ENTER || e.key == GLFW_KEY_KP_ENTER)) {
+            module->setPattern(getText());
+            ui::MenuOverlay* overlay = getAncestorOfType<ui::MenuOverlay>();
+            if (overlay)
+                overlay->requestDelete();
+            e.consume(this);
+        }
+        if (!e.getTarget())
+            ui::TextField::onSelectKey(e);
+    }
+};
 
-        lights[PAIRS_AND_LIGHT].setBrightnessSmooth(pairsAnd ? 1.f : 0.f, args.sampleTime);
-        lights[PAIRS_OR_LIGHT].setBrightnessSmooth(pairsOr ? 1.f : 0.f, args.sampleTime);
-        lights[PAIRS_XOR_LIGHT].setBrightnessSmooth(pairsXor ? 1.f : 0.f, args.sampleTime);
+// Context-menu slider bound to a module parameter
+struct ParamMenuSlider : ui::Slider {
+    ParamMenuSlider(ParamQuantity* pq) {
+        quantity = pq;
+        box.size.x = 200.f;
     }
 };
 
@@ -489,6 +2352,319 @@ struct ComparallyWidget : ModuleWidget {
         addChild(createWidget<ScrewSilver>(Vec(RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
         addChild(createWidget<ScrewSilver>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
     }
+
+    // Picks up PITCH HYSTERESIS changes made outside the module's own
+    // events (menu slider, MIDI map, undo) on the UI thread, where the pitch
+    // tables are built
+    void step() override {
+        if (Comparally* module = getModule<Comparally>())
+            module->publishPitchTables();
+        ModuleWidget::step();
+    }
+
+    void appendContextMenu(Menu* menu) override {
+        Comparally* module = getModule<Comparally>();
+
+        menu->addChild(new MenuSeparator);
+        menu->addChild(new ParamMenuSlider(module->paramQuantities[Comparally::HYSTERESIS_PARAM]));
+        menu->addChild(createSubmenuItem("Adaptive hysteresis", "", [=](Menu* menu) {
+            for (int c = 0; c < 4; c++) {
+                menu->addChild(createBoolMenuItem(CHANNEL_NAMES[c], "",
+                    [=]() { return module->adaptiveModes[c].load(); },
+                    [=](bool enabled) { module->setAdaptiveMode(c, enabled); }
+                ));
+            }
+            menu->addChild(new ParamMenuSlider(module->paramQuantities[Comparally::ADAPTIVE_HYSTERESIS_PARAM]));
+        }));
+
+        menu->addChild(createSubmenuItem("Window snapshots", string::f("%d", module->snapshots.count), [=](Menu* menu) {
+            menu->addChild(createMenuLabel("MORPH 0-10 V sweeps from the first to the last snapshot"));
+            for (int i = 0; i < module->snapshots.count; i++) {
+                menu->addChild(createSubmenuItem(string::f("Snapshot %d", i + 1), "", [=](Menu* menu) {
+                    menu->addChild(createMenuItem("Recall to knobs", "", [=]() { module->recallSnapshot(i); }));
+                    menu->addChild(createMenuItem("Overwrite with knobs", "", [=]() { module->storeSnapshot(i); }));
+                    menu->addChild(createMenuItem("Remove", "", [=]() { module->removeSnapshot(i); }));
+                }));
+            }
+            if (module->snapshots.count < Comparally::MAX_SNAPSHOTS) {
+                int next = module->snapshots.count;
+                menu->addChild(createMenuItem(string::f("Store knobs as snapshot %d", next + 1), "", [=]() {
+                    module->storeSnapshot(next);
+                }));
+            }
+        }));
+
+        menu->addChild(createMenuLabel("SHIFT/SIZE CV slew"));
+        for (int c = 0; c < 4; c++) {
+            menu->addChild(new ParamMenuSlider(module->paramQuantities[Comparally::A_SLEW_PARAM + c]));
+        }
+
+        menu->addChild(createSubmenuItem("Relative mode", "", [=](Menu* menu) {
+            for (int c = 0; c < 4; c++) {
+                int source = module->relativeSources[c];
+                std::string current = (source >= 0) ? string::f("Around %s", CHANNEL_NAMES[source]) : "";
+                menu->addChild(createSubmenuItem(CHANNEL_NAMES[c], current, [=](Menu* menu) {
+                    menu->addChild(createCheckMenuItem("Off (absolute)", "",
+                        [=]() { return module->relativeSources[c] < 0; },
+                        [=]() { module->setRelativeSource(c, -1); }
+                    ));
+                    for (int s = 0; s < 4; s++) {
+                        if (s == c)
+                            continue;
+                        menu->addChild(createCheckMenuItem(string::f("Center on input %s", CHANNEL_NAMES[s]), "",
+                            [=]() { return module->relativeSources[c] == s; },
+                            [=]() { module->setRelativeSource(c, s); }
+                        ));
+                    }
+                }));
+            }
+        }));
+
+        menu->addChild(createSubmenuItem("Glitch filter (median)", "", [=](Menu* menu) {
+            static const int lengths[] = {1, 3, 5, 7, 9, 15, 21, 31};
+            for (int c = 0; c < 4; c++) {
+                menu->addChild(createIndexSubmenuItem(CHANNEL_NAMES[c],
+                    {"Off", "3 samples", "5 samples", "7 samples", "9 samples", "15 samples", "21 samples", "31 samples"},
+                    [=]() {
+                        for (int i = 0; i < 8; i++) {
+                            if (lengths[i] == module->medianLengths[c])
+                                return (size_t) i;
+                        }
+                        return (size_t) 0;
+                    },
+                    [=](size_t i) { module->setMedianLength(c, lengths[i]); }
+                ));
+            }
+        }));
+
+        menu->addChild(createSubmenuItem("Envelope detector", "", [=](Menu* menu) {
+            for (int c = 0; c < 4; c++) {
+                menu->addChild(createIndexSubmenuItem(CHANNEL_NAMES[c],
+                    {"Off (raw input)", "Peak", "RMS", "Log (1 V/10 dB, 0 V = 5 V peak)", "Spectral band of input A (log scale)"},
+                    [=]() { return (size_t) module->detectorModes[c]; },
+                    [=](size_t mode) { module->setDetectorMode(c, mode); }
+                ));
+            }
+            menu->addChild(new ParamMenuSlider(module->paramQuantities[Comparally::DETECTOR_ATTACK_PARAM]));
+            menu->addChild(new ParamMenuSlider(module->paramQuantities[Comparally::DETECTOR_RELEASE_PARAM]));
+            menu->addChild(createSubmenuItem("Spectral bands", "", [=](Menu* menu) {
+                for (int i = 0; i < 8; i++) {
+                    menu->addChild(new ParamMenuSlider(module->paramQuantities[Comparally::A_BAND_LOW_PARAM + i]));
+                }
+            }));
+        }));
+
+        menu->addChild(createSubmenuItem("Pitch mode", "", [=](Menu* menu) {
+            static const char* const noteNames[12] = {"C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"};
+            static const char* const scaleNames[4] = {"Chromatic", "Major", "Natural minor", "Major pentatonic"};
+            static const int scalePresets[4] = {0xfff, 0xab5, 0x5ad, 0x295};
+            for (int c = 0; c < 4; c++) {
+                menu->addChild(createSubmenuItem(CHANNEL_NAMES[c], module->pitchModes[c] ? "On" : "", [=](Menu* menu) {
+                    menu->addChild(createBoolMenuItem("Match scale", "",
+                        [=]() { return module->pitchModes[c].load(); },
+                        [=](bool enabled) { module->setPitchMode(c, enabled); }
+                    ));
+                    menu->addChild(new MenuSeparator);
+                    for (int i = 0; i < 4; i++) {
+                        menu->addChild(createMenuItem(scaleNames[i], "", [=]() {
+                            module->scaleMasks[c] = scalePresets[i];
+                            module->publishPitchTables();
+                        }));
+                    }
+                    menu->addChild(new MenuSeparator);
+                    for (int n = 0; n < 12; n++) {
+                        menu->addChild(createCheckMenuItem(noteNames[n], "",
+                            [=]() { return ((module->scaleMasks[c] >> n) & 1) != 0; },
+                            [=]() {
+                                module->scaleMasks[c] ^= 1 << n;
+                                module->publishPitchTables();
+                            }
+                        ));
+                    }
+                }));
+            }
+            menu->addChild(new ParamMenuSlider(module->paramQuantities[Comparally::PITCH_HYSTERESIS_PARAM]));
+        }));
+
+        menu->addChild(createSubmenuItem("Gate output shape", "", [=](Menu* menu) {
+            menu->addChild(createIndexPtrSubmenuItem("HI/WIN/LO outputs",
+                {"Off (hard gates)", "Linear", "Exponential", "Raised cosine"}, &module->outputShape));
+            menu->addChild(new ParamMenuSlider(module->paramQuantities[Comparally::OUTPUT_SLEW_PARAM]));
+        }));
+
+        menu->addChild(createSubmenuItem("Gate output levels", "", [=](Menu* menu) {
+            static const char* const groupNames[Comparally::NUM_OUTPUT_GROUPS] = {"HI/WIN/LO", "Logic", "Expansion gates"};
+            for (int g = 0; g < Comparally::NUM_OUTPUT_GROUPS; g++) {
+                menu->addChild(createSubmenuItem(groupNames[g], module->outputInverted[g] ? "Inverted" : "", [=](Menu* menu) {
+                    menu->addChild(new ParamMenuSlider(module->paramQuantities[Comparally::CHANNELS_HIGH_PARAM + 2 * g]));
+                    menu->addChild(new ParamMenuSlider(module->paramQuantities[Comparally::CHANNELS_LOW_PARAM + 2 * g]));
+                    menu->addChild(createBoolPtrMenuItem("Invert", "", &module->outputInverted[g]));
+                }));
+            }
+        }));
+
+        menu->addChild(createIndexPtrSubmenuItem("Measurement window", {"100 ms", "1 s", "10 s"}, &module->measureWindow));
+
+        menu->addChild(createSubmenuItem("Sample & hold on", "", [=](Menu* menu) {
+            for (int c = 0; c < 4; c++) {
+                menu->addChild(createIndexSubmenuItem(CHANNEL_NAMES[c],
+                    {"Window entry", "Window exit", "Entry and exit", "Any HI/WIN/LO change"},
+                    [=]() { return (size_t) module->sampleHoldModes[c]; },
+                    [=](size_t mode) { module->setSampleHoldMode(c, mode); }
+                ));
+            }
+        }));
+
+        static const int blockSizes[] = {1, 8, 16, 32};
+        menu->addChild(createIndexSubmenuItem("Processing",
+            {"Per sample (no latency)", "Block of 8 (8 samples latency)", "Block of 16 (16 samples latency)", "Block of 32 (32 samples latency)"},
+            [=]() {
+                for (int i = 0; i < 4; i++) {
+                    if (blockSizes[i] == module->blockSize)
+                        return (size_t) i;
+                }
+                return (size_t) 0;
+            },
+            [=](size_t i) {
+                module->blockSize = blockSizes[i];
+            }
+        ));
+        static const int cvDividers[] = {1, 4, 8, 16, 32};
+        menu->addChild(createIndexSubmenuItem("SHIFT/SIZE CV rate",
+            {"Every sample", "Every 4 samples", "Every 8 samples", "Every 16 samples", "Every 32 samples"},
+            [=]() {
+                for (int i = 0; i < 5; i++) {
+                    if (cvDividers[i] == module->cvDivider)
+                        return (size_t) i;
+                }
+                return (size_t) 0;
+            },
+            [=](size_t i) {
+                module->cvDivider = cvDividers[i];
+            }
+        ));
+        if (module->getLatency() > 0) {
+            menu->addChild(createMenuLabel(string::f("Output latency: %d samples", module->getLatency())));
+        }
+
+        menu->addChild(createMenuLabel("WIN entry divisions"));
+        for (int c = 0; c < 4; c++) {
+            menu->addChild(new ParamMenuSlider(module->paramQuantities[Comparally::A_DIVISION_PARAM + c]));
+        }
+
+        menu->addChild(createMenuLabel("Delayed gate outputs"));
+        menu->addChild(new ParamMenuSlider(module->paramQuantities[Comparally::DELAY_PARAM]));
+        menu->addChild(new ParamMenuSlider(module->paramQuantities[Comparally::LOGIC_DELAY_PARAM]));
+
+        std::vector<std::string> busSlotNames = {"Off"};
+        for (int i = 0; i < NUM_BUS_SLOTS; i++) {
+            busSlotNames.push_back(string::f("Slot %d", i + 1));
+        }
+        menu->addChild(createSubmenuItem("State bus", "", [=](Menu* menu) {
+            menu->addChild(createIndexSubmenuItem("Publish to", busSlotNames,
+                [=]() { return (size_t) (module->busPublishSlot + 1); },
+                [=](size_t i) { module->busPublishSlot = (int) i - 1; }
+            ));
+            // A duplicated module publishes to the same slot as its original
+            int slot = module->busPublishSlot;
+            if (slot >= 0 && busPublishers(slot) > 1)
+                menu->addChild(createMenuLabel(string::f("%d modules publish to slot %d", busPublishers(slot), slot + 1)));
+            menu->addChild(createIndexSubmenuItem("Listen to (BUS output)", busSlotNames,
+                [=]() { return (size_t) (module->busListenSlot + 1); },
+                [=](size_t i) { module->busListenSlot = (int) i - 1; }
+            ));
+        }));
+
+        menu->addChild(createSubmenuItem("Pattern", "", [=](Menu* menu) {
+            menu->addChild(createMenuLabel("Steps: +GATE or -GATE, optional /ms timeout (Enter to apply)"));
+            menu->addChild(createMenuLabel("Gates: A_HI..D_LO, AB_AND..CD_FF, PAIRS_AND/OR/XOR"));
+            menu->addChild(new PatternField(module));
+            if (!module->patternError.empty()) {
+                menu->addChild(createMenuLabel(module->patternError));
+            }
+            menu->addChild(createIndexPtrSubmenuItem("MATCH output", {"Trigger", "Gate (until last step reverts)"}, &module->matchMode));
+        }));
+
+        menu->addChild(createSubmenuItem("Input recording", "", [=](Menu* menu) {
+            if (module->isRecording()) {
+                float seconds = module->recorder->writtenFrames.load() / APP->engine->getSampleRate();
+                menu->addChild(createMenuItem("Stop recording", string::f("%.1f s", seconds), [=]() {
+                    module->stopRecording();
+                }));
+                if (module->recorder->droppedFrames.load() > 0) {
+                    menu->addChild(createMenuLabel(string::f("%u frames dropped", (unsigned) module->recorder->droppedFrames.load())));
+                }
+            }
+            else {
+                if (module->recorder && module->recorder->failed.load()) {
+                    menu->addChild(createMenuLabel("Recording stopped: write failed"));
+                }
+                menu->addChild(createMenuItem("Record inputs...", "", [=]() {
+                    osdialog_filters* filters = osdialog_filters_parse("Comparally recording (.cmpr):cmpr");
+                    char* pathC = osdialog_file(OSDIALOG_SAVE, NULL, "inputs.cmpr", filters);
+                    osdialog_filters_free(filters);
+                    if (!pathC)
+                        return;
+                    std::string path = pathC;
+                    std::free(pathC);
+                    if (system::getExtension(path) != ".cmpr")
+                        path += ".cmpr";
+                    module->startRecording(path);
+                }));
+            }
+
+            menu->addChild(new MenuSeparator);
+            if (!module->replayPath.empty()) {
+                menu->addChild(createMenuItem("Stop replay", system::getFilename(module->replayPath), [=]() {
+                    module->setReplay("");
+                }));
+            }
+            menu->addChild(createMenuItem("Replay recording...", "", [=]() {
+                osdialog_filters* filters = osdialog_filters_parse("Comparally recording (.cmpr):cmpr");
+                char* pathC = osdialog_file(OSDIALOG_OPEN, NULL, NULL, filters);
+                osdialog_filters_free(filters);
+                if (!pathC)
+                    return;
+                std::string path = pathC;
+                std::free(pathC);
+                module->setReplay(path);
+            }));
+        }));
+
+        menu->addChild(createSubmenuItem("Suggested windows", "", [=](Menu* menu) {
+            menu->addChild(createBoolMenuItem("Learn from inputs", "",
+                [=]() { return module->learnInputs.load(); },
+                [=](bool enabled) { module->setLearnInputs(enabled); }
+            ));
+            if (!module->learnInputs.load())
+                return;
+            menu->addChild(new MenuSeparator);
+
+            for (int c = 0; c < 4; c++) {
+                WindowSuggestion suggestions[AnalysisFeed::NUM_SUGGESTIONS];
+                if (!module->analysisFeed.getSuggestions(c, suggestions)) {
+                    menu->addChild(createMenuLabel(string::f("%s: collecting input...", CHANNEL_NAMES[c])));
+                    continue;
+                }
+                menu->addChild(createSubmenuItem(CHANNEL_NAMES[c], "", [=](Menu* menu) {
+                    for (int i = 0; i < AnalysisFeed::NUM_SUGGESTIONS; i++) {
+                        WindowSuggestion s = suggestions[i];
+                        std::string text = string::f("%d-%d%%: %.2f V to %.2f V",
+                            (int) std::round(s.lowPercentile * 100.f), (int) std::round(s.highPercentile * 100.f), s.lo, s.hi);
+                        menu->addChild(createMenuItem(text, "", [=]() {
+                            // SHIFT is the window center, SIZE its full width
+                            module->paramQuantities[Comparally::A_SHIFT_PARAM + 2 * c]->setValue(0.5f * (s.lo + s.hi));
+                            module->paramQuantities[Comparally::A_SIZE_PARAM + 2 * c]->setValue(s.hi - s.lo);
+                        }));
+                    }
+                }));
+            }
+            menu->addChild(new MenuSeparator);
+            menu->addChild(createMenuItem("Reset learned statistics", "", [=]() {
+                module->analysisFeed.resetRequested = true;
+            }));
+        }));
+    }
 };
 
 Model* modelComparally = createModel<Comparally, ComparallyWidget>("Comparally");
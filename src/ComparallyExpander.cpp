@@ -0,0 +1,135 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2025 ifnoon
+// Part of the ifnoon VCV Rack plugin project.
+
+/*
+ * ComparallyExpander.cpp - 10HP Jack Expander for Comparally
+ *
+ * Passes Comparally's expansion outputs to its jacks and reports its
+ * inputs and patched outputs back. Without a Comparally directly to its
+ * left, every output sits at 0 V.
+ */
+
+#include "ComparallyExpander.hpp"
+#include "componentlibrary.hpp"
+#include <algorithm>
+
+ComparallyExpander::ComparallyExpander() {
+    config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
+    leftExpander.producerMessage = &messages[0];
+    leftExpander.consumerMessage = &messages[1];
+
+    configInput(RESET_INPUT, "Reset WIN entry counters");
+    configInput(MORPH_INPUT, "Snapshot morph (0-10 V: first to last snapshot)");
+
+    configOutput(DWELL_OUTPUT, "Time in current state A..D (1 V/s, poly)");
+    configOutput(DUTY_OUTPUT,  "WIN duty cycle A..D (10 V = 100%, poly)");
+    configOutput(RATE_OUTPUT,  "Crossing rate A..D (1 V = 10 Hz, poly)");
+
+    configOutput(RISE_OUTPUT,       "HI/WIN/LO rising triggers (HI A..D, WIN A..D, LO A..D, poly)");
+    configOutput(FALL_OUTPUT,       "HI/WIN/LO falling triggers (HI A..D, WIN A..D, LO A..D, poly)");
+    configOutput(LOGIC_RISE_OUTPUT, "Logic rising triggers (A+B, C+D, Pairs, poly)");
+    configOutput(LOGIC_FALL_OUTPUT, "Logic falling triggers (A+B, C+D, Pairs, poly)");
+
+    configOutput(SH_OUTPUT, "Input sampled on window transition A..D (poly)");
+    configOutput(PASS_OUTPUT, "Input passed while inside window A..D (poly)");
+    configOutput(MATCH_OUTPUT, "Pattern match");
+    configOutput(DELAY_OUTPUT, "Delayed HI A..D, WIN A..D, LO A..D (poly)");
+    configOutput(LOGIC_DELAY_OUTPUT, "Delayed logic AB, CD, Pairs (poly)");
+    configOutput(DIV_OUTPUT, "WIN of every Nth window entry A..D (poly)");
+    configOutput(COUNT_OUTPUT, "WIN entry count modulo N A..D (poly)");
+    configOutput(BUS_OUTPUT, "WIN with bus WIN: AND A..D, OR A..D, XOR A..D (poly)");
+
+    configLight(LINK_LIGHT, "Connected to Comparally");
+}
+
+void ComparallyExpander::process(const ProcessArgs& args) {
+    bool linked = leftExpander.module && leftExpander.module->model == modelComparally;
+    lights[LINK_LIGHT].setBrightness(linked);
+
+    // Outputs Comparally has not rendered yet (just patched, or no
+    // Comparally) read 0 V
+    const OutputMessage* message = (const OutputMessage*) leftExpander.consumerMessage;
+    for (int i = 0; i < NUM_OUTPUTS; i++) {
+        int channels = linked ? message->channels[i] : 0;
+        outputs[i].setChannels(std::max(channels, 1));
+        for (int c = 0; c < channels; c++) {
+            outputs[i].setVoltage(message->voltages[i][c], c);
+        }
+        if (channels == 0)
+            outputs[i].setVoltage(0.f);
+    }
+
+    if (!linked)
+        return;
+    InputMessage* reply = (InputMessage*) leftExpander.module->rightExpander.producerMessage;
+    for (int i = 0; i < NUM_INPUTS; i++) {
+        reply->voltages[i] = inputs[i].getVoltage();
+        reply->inputConnected[i] = inputs[i].isConnected();
+    }
+    for (int i = 0; i < NUM_OUTPUTS; i++) {
+        reply->outputConnected[i] = outputs[i].isConnected();
+    }
+    leftExpander.module->rightExpander.requestMessageFlip();
+}
+
+struct ComparallyExpanderWidget : ModuleWidget {
+    ComparallyExpanderWidget(ComparallyExpander* module) {
+        setModule(module);
+
+        // 10HP panel (50.8 mm)
+        box.size = Vec(RACK_GRID_WIDTH * 10, RACK_GRID_HEIGHT);
+        setPanel(createPanel(asset::plugin(pluginInstance, "res/ComparallyExpander.svg")));
+
+        // 3 x 7 jack grid; rows line up with Comparally's logic jacks.
+        // Slots fill left-to-right, top-to-bottom.
+        const float xJACK[3] = {11.0f, 25.5f, 40.0f};
+        const float yJACK[7] = {19.645837f, 34.940447f, 53.212499f, 67.295830f, 87.057114f, 98.814629f, 110.572144f};
+        auto slot = [&](int i) {
+            return mm2px(Vec(xJACK[i % 3], yJACK[i / 3]));
+        };
+
+        addChild(createLightCentered<SmallLight<GreenLight>>(mm2px(Vec(44.5f, 4.4f)), module, ComparallyExpander::LINK_LIGHT));
+
+        // Measurements (poly A..D)
+        addOutput(createOutputCentered<PJ301MPort>(slot(0), module, ComparallyExpander::DWELL_OUTPUT));
+        addOutput(createOutputCentered<PJ301MPort>(slot(1), module, ComparallyExpander::DUTY_OUTPUT));
+        addOutput(createOutputCentered<PJ301MPort>(slot(2), module, ComparallyExpander::RATE_OUTPUT));
+
+        // Edge triggers
+        addOutput(createOutputCentered<PJ301MPort>(slot(3), module, ComparallyExpander::RISE_OUTPUT));
+        addOutput(createOutputCentered<PJ301MPort>(slot(4), module, ComparallyExpander::FALL_OUTPUT));
+        addOutput(createOutputCentered<PJ301MPort>(slot(6), module, ComparallyExpander::LOGIC_RISE_OUTPUT));
+        addOutput(createOutputCentered<PJ301MPort>(slot(7), module, ComparallyExpander::LOGIC_FALL_OUTPUT));
+
+        // Sample & hold and window-gated pass-through (poly A..D)
+        addOutput(createOutputCentered<PJ301MPort>(slot(5), module, ComparallyExpander::SH_OUTPUT));
+        addOutput(createOutputCentered<PJ301MPort>(slot(8), module, ComparallyExpander::PASS_OUTPUT));
+
+        // Pattern matcher
+        addOutput(createOutputCentered<PJ301MPort>(slot(9), module, ComparallyExpander::MATCH_OUTPUT));
+
+        // Delayed gates
+        addOutput(createOutputCentered<PJ301MPort>(slot(10), module, ComparallyExpander::DELAY_OUTPUT));
+        addOutput(createOutputCentered<PJ301MPort>(slot(11), module, ComparallyExpander::LOGIC_DELAY_OUTPUT));
+
+        // WIN-entry counters
+        addInput(createInputCentered<PJ301MPort>(slot(12), module, ComparallyExpander::RESET_INPUT));
+        addOutput(createOutputCentered<PJ301MPort>(slot(13), module, ComparallyExpander::DIV_OUTPUT));
+        addOutput(createOutputCentered<PJ301MPort>(slot(14), module, ComparallyExpander::COUNT_OUTPUT));
+
+        // Snapshot morph
+        addInput(createInputCentered<PJ301MPort>(slot(15), module, ComparallyExpander::MORPH_INPUT));
+
+        // State bus
+        addOutput(createOutputCentered<PJ301MPort>(slot(16), module, ComparallyExpander::BUS_OUTPUT));
+
+        // Add VCV Rack mounting screws
+        addChild(createWidget<ScrewSilver>(Vec(RACK_GRID_WIDTH, 0)));
+        addChild(createWidget<ScrewSilver>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, 0)));
+        addChild(createWidget<ScrewSilver>(Vec(RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
+        addChild(createWidget<ScrewSilver>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
+    }
+};
+
+Model* modelComparallyExpander = createModel<ComparallyExpander, ComparallyExpanderWidget>("ComparallyExpander");
@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2025 ifnoon
+// Part of the ifnoon VCV Rack plugin project.
+
+/*
+ * ComparallyExpander.hpp - 10HP Jack Expander for Comparally
+ *
+ * Placed directly right of a Comparally, the expander carries the jacks
+ * that do not fit the 20HP panel: measurements, triggers, S&H/pass,
+ * match, delayed gates, entry counters, morph and bus.
+ * - Comparally computes every output and sends the voltages across each
+ *   sample; the expander sends back its two inputs and which outputs are
+ *   patched, so unpatched outputs cost no work
+ * - Both directions go through Rack's double-buffered expander messages
+ *   and arrive one sample late
+ */
+
+#pragma once
+
+#include "plugin.hpp"
+
+struct ComparallyExpander : Module {
+    enum ParamIds {
+        NUM_PARAMS
+    };
+    enum InputIds {
+        // Resets the WIN-entry counters
+        RESET_INPUT,
+        // Sweeps across the stored window snapshots
+        MORPH_INPUT,
+        NUM_INPUTS
+    };
+    enum OutputIds {
+        // Measurement outputs (polyphonic, channels A..D)
+        DWELL_OUTPUT,
+        DUTY_OUTPUT,
+        RATE_OUTPUT,
+        // Edge triggers (polyphonic, one channel per state bit)
+        RISE_OUTPUT,
+        FALL_OUTPUT,
+        LOGIC_RISE_OUTPUT,
+        LOGIC_FALL_OUTPUT,
+        // Sample & hold of the inputs on window transitions (poly A..D)
+        SH_OUTPUT,
+        // Inputs gated by WIN (poly A..D)
+        PASS_OUTPUT,
+        // Pattern matcher trigger/gate
+        MATCH_OUTPUT,
+        // Delayed gates (polyphonic, one channel per state bit)
+        DELAY_OUTPUT,
+        LOGIC_DELAY_OUTPUT,
+        // WIN-entry divider gates and counts (poly A..D)
+        DIV_OUTPUT,
+        COUNT_OUTPUT,
+        // Local WIN AND/OR/XOR the bus slot's WIN (poly, 3 x A..D)
+        BUS_OUTPUT,
+        NUM_OUTPUTS
+    };
+    enum LightIds {
+        LINK_LIGHT,
+        NUM_LIGHTS
+    };
+
+    // Comparally -> expander: every output, as Comparally rendered it
+    struct OutputMessage {
+        float voltages[NUM_OUTPUTS][PORT_MAX_CHANNELS] = {};
+        uint8_t channels[NUM_OUTPUTS] = {};
+    };
+
+    // Expander -> Comparally: the inputs and which outputs are patched
+    struct InputMessage {
+        float voltages[NUM_INPUTS] = {};
+        bool inputConnected[NUM_INPUTS] = {};
+        bool outputConnected[NUM_OUTPUTS] = {};
+    };
+
+    // Receive buffers for the messages from Comparally on the left
+    OutputMessage messages[2];
+
+    ComparallyExpander();
+    void process(const ProcessArgs& args) override;
+};
@@ -0,0 +1,189 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2025 ifnoon
+// Part of the ifnoon VCV Rack plugin project.
+
+/*
+ * InputAnalysis.cpp - Background Input Statistics for ifnoon Modules
+ *
+ * Implements the log-binned histograms, the percentile-band suggestions
+ * and the periodic scheduler job that services every AnalysisFeed.
+ */
+
+#include "InputAnalysis.hpp"
+#include "JobScheduler.hpp"
+#include <algorithm>
+#include <vector>
+
+constexpr float LogHistogram::MIN_MAGNITUDE;
+constexpr float LogHistogram::MAX_MAGNITUDE;
+
+// Percentile bands offered as suggestions, widest first
+static const float SUGGESTION_BANDS[AnalysisFeed::NUM_SUGGESTIONS][2] = {
+    {0.05f, 0.95f},
+    {0.10f, 0.90f},
+    {0.25f, 0.75f},
+    {0.40f, 0.60f},
+};
+
+// Weight (decimated samples) after which the histogram is halved, so the
+// statistics follow roughly the last 10-20 seconds of input
+static const float MAX_HISTOGRAM_WEIGHT = 16384.f;
+// Weight needed before suggestions are offered
+static const float MIN_HISTOGRAM_WEIGHT = 256.f;
+
+// ======= LogHistogram =======
+
+static float logMagnitudeRange() {
+    return std::log(LogHistogram::MAX_MAGNITUDE / LogHistogram::MIN_MAGNITUDE);
+}
+
+void LogHistogram::add(float v) {
+    float magnitude = std::fabs(v);
+    int bin = BINS_PER_SIGN;
+    if (magnitude >= MIN_MAGNITUDE) {
+        int k = (int) (std::log(magnitude / MIN_MAGNITUDE) / logMagnitudeRange() * BINS_PER_SIGN);
+        k = clamp(k, 0, BINS_PER_SIGN - 1);
+        bin = (v > 0.f) ? BINS_PER_SIGN + 1 + k : BINS_PER_SIGN - 1 - k;
+    }
+    counts[bin] += 1.f;
+    total += 1.f;
+}
+
+void LogHistogram::scale(float factor) {
+    for (int i = 0; i < NUM_BINS; i++) {
+        counts[i] *= factor;
+    }
+    total *= factor;
+}
+
+void LogHistogram::clear() {
+    scale(0.f);
+}
+
+// Geometric center of a bin's magnitude range, with the bin's sign
+static float binValue(int bin) {
+    if (bin == LogHistogram::BINS_PER_SIGN)
+        return 0.f;
+    int k = (bin > LogHistogram::BINS_PER_SIGN) ? bin - LogHistogram::BINS_PER_SIGN - 1 : LogHistogram::BINS_PER_SIGN - 1 - bin;
+    float magnitude = LogHistogram::MIN_MAGNITUDE * std::exp((k + 0.5f) / LogHistogram::BINS_PER_SIGN * logMagnitudeRange());
+    return (bin > LogHistogram::BINS_PER_SIGN) ? magnitude : -magnitude;
+}
+
+float LogHistogram::percentile(float p) const {
+    float target = p * total;
+    float cumulative = 0.f;
+    for (int i = 0; i < NUM_BINS; i++) {
+        cumulative += counts[i];
+        if (cumulative >= target && counts[i] > 0.f)
+            return binValue(i);
+    }
+    return 0.f;
+}
+
+// ======= AnalysisFeed =======
+
+void AnalysisFeed::analyze() {
+    if (resetRequested.exchange(false)) {
+        for (int c = 0; c < NUM_CHANNELS; c++) {
+            histograms[c].clear();
+        }
+    }
+
+    simd::float_4 frame;
+    int popped = 0;
+    while (samples.pop(frame)) {
+        for (int c = 0; c < NUM_CHANNELS; c++) {
+            histograms[c].add(frame[c]);
+        }
+        popped++;
+    }
+    if (popped == 0)
+        return;
+
+    bool ready[NUM_CHANNELS];
+    WindowSuggestion next[NUM_CHANNELS][NUM_SUGGESTIONS];
+    for (int c = 0; c < NUM_CHANNELS; c++) {
+        LogHistogram& histogram = histograms[c];
+        if (histogram.total > MAX_HISTOGRAM_WEIGHT)
+            histogram.scale(0.5f);
+
+        ready[c] = histogram.total >= MIN_HISTOGRAM_WEIGHT;
+        for (int i = 0; i < NUM_SUGGESTIONS; i++) {
+            WindowSuggestion& suggestion = next[c][i];
+            suggestion.lowPercentile = SUGGESTION_BANDS[i][0];
+            suggestion.highPercentile = SUGGESTION_BANDS[i][1];
+            suggestion.lo = histogram.percentile(suggestion.lowPercentile);
+            suggestion.hi = histogram.percentile(suggestion.highPercentile);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(resultMutex);
+    for (int c = 0; c < NUM_CHANNELS; c++) {
+        suggestionsReady[c] = ready[c];
+        std::copy(next[c], next[c] + NUM_SUGGESTIONS, suggestions[c]);
+    }
+}
+
+bool AnalysisFeed::getSuggestions(int channel, WindowSuggestion* out) {
+    std::lock_guard<std::mutex> lock(resultMutex);
+    if (!suggestionsReady[channel])
+        return false;
+    std::copy(suggestions[channel], suggestions[channel] + NUM_SUGGESTIONS, out);
+    return true;
+}
+
+// ======= Worker =======
+
+namespace {
+
+// Milliseconds between two passes over all feeds. The feed queues hold
+// over a second of decimated input, so this leaves plenty of headroom.
+const int ANALYSIS_PERIOD_MS = 50;
+
+std::mutex feedsMutex;
+std::vector<AnalysisFeed*> feeds;
+
+// Periodic scheduler job servicing every registered feed, one pass per tick
+struct AnalysisJob : Job {
+    void run() override {
+        std::lock_guard<std::mutex> lock(feedsMutex);
+        for (AnalysisFeed* feed : feeds) {
+            feed->analyze();
+        }
+    }
+};
+
+std::shared_ptr<AnalysisJob> analysisJob;
+// Serializes register/unregister so the job is started and stopped once
+std::mutex lifecycleMutex;
+
+}
+
+void registerAnalysisFeed(AnalysisFeed* feed) {
+    std::lock_guard<std::mutex> lifecycleLock(lifecycleMutex);
+    {
+        std::lock_guard<std::mutex> lock(feedsMutex);
+        feeds.push_back(feed);
+    }
+    if (!analysisJob) {
+        analysisJob = std::make_shared<AnalysisJob>();
+        schedulePeriodicJob(analysisJob, ANALYSIS_PERIOD_MS);
+    }
+}
+
+void unregisterAnalysisFeed(AnalysisFeed* feed) {
+    std::lock_guard<std::mutex> lifecycleLock(lifecycleMutex);
+    bool empty;
+    {
+        // Once this lock is held the job is not inside feed->analyze()
+        std::lock_guard<std::mutex> lock(feedsMutex);
+        feeds.erase(std::remove(feeds.begin(), feeds.end(), feed), feeds.end());
+        empty = feeds.empty();
+    }
+
+    if (empty && analysisJob) {
+        analysisJob->cancel();
+        analysisJob->wait();
+        analysisJob.reset();
+    }
+}
@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2025 ifnoon
+// Part of the ifnoon VCV Rack plugin project.
+
+/*
+ * InputAnalysis.hpp - Background Input Statistics for ifnoon Modules
+ *
+ * Modules own an AnalysisFeed, register it while learning is enabled and
+ * push a decimated stream of their four compared levels into it from the
+ * audio thread (wait-free). One periodic job on the plugin's JobScheduler
+ * drains every feed into log-binned histograms and publishes percentile-band window suggestions for the context menu.
+ * Nothing but the queue push happens on the audio thread.
+ */
+
+#pragma once
+
+#include "plugin.hpp"
+#include "SpscQueue.hpp"
+#include <atomic>
+#include <mutex>
+
+// Signed histogram with logarithmically spaced magnitude bins, so small
+// CV offsets and full-scale audio both get useful resolution.
+struct LogHistogram {
+    static const int BINS_PER_SIGN = 48;
+    // [0, BINS_PER_SIGN): negative, large to small magnitude
+    // BINS_PER_SIGN: |v| below MIN_MAGNITUDE
+    // (BINS_PER_SIGN, NUM_BINS): positive, small to large magnitude
+    static const int NUM_BINS = 2 * BINS_PER_SIGN + 1;
+    static constexpr float MIN_MAGNITUDE = 1e-3f;
+    static constexpr float MAX_MAGNITUDE = 12.f;
+
+    float counts[NUM_BINS] = {};
+    float total = 0.f;
+
+    void add(float v);
+    void scale(float factor);
+    void clear();
+    // Value below which fraction `p` of the weight lies (bin resolution)
+    float percentile(float p) const;
+};
+
+// A suggested window as a percentile band of the input distribution
+struct WindowSuggestion {
+    float lowPercentile;
+    float highPercentile;
+    float lo;   // V
+    float hi;   // V
+};
+
+struct AnalysisFeed {
+    static const int NUM_CHANNELS = 4;
+    static const int NUM_SUGGESTIONS = 4;
+    // Audio-rate frames between two pushed samples
+    static const int DECIMATION = 32;
+
+    // Audio thread -> worker
+    SpscQueue<simd::float_4, 2048> samples;
+    // UI -> worker: drop the learned statistics
+    std::atomic<bool> resetRequested{false};
+
+    // Worker-owned
+    LogHistogram histograms[NUM_CHANNELS];
+
+    // Worker -> UI, guarded by resultMutex (never taken on the audio thread)
+    std::mutex resultMutex;
+    bool suggestionsReady[NUM_CHANNELS] = {};
+    WindowSuggestion suggestions[NUM_CHANNELS][NUM_SUGGESTIONS];
+
+    // Runs on the worker: drains the queue and refreshes the suggestions
+    void analyze();
+
+    // UI thread: copies the channel's suggestions, false if not enough data yet
+    bool getSuggestions(int channel, WindowSuggestion* out);
+};
+
+// Register/unregister from the UI thread (not the audio thread); the feed
+// stays owned by the caller. The analysis job runs while at least one feed
+// is registered, and is not inside analyze() once unregister returns.
+void registerAnalysisFeed(AnalysisFeed* feed);
+void unregisterAnalysisFeed(AnalysisFeed* feed);
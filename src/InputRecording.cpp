@@ -0,0 +1,199 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2025 ifnoon
+// Part of the ifnoon VCV Rack plugin project.
+
+/*
+ * InputRecording.cpp - Input Capture and Deterministic Replay
+ *
+ * Writer job and file mapping for recorded input streams.
+ */
+
+#include "plugin.hpp"
+#include "InputRecording.hpp"
+
+#if !defined ARCH_WIN
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+static const char RECORDING_MAGIC[4] = {'C', 'M', 'P', 'R'};
+
+// ======= InputRecorder =======
+
+InputRecorder::~InputRecorder() {
+    if (file)
+        std::fclose(file);
+}
+
+std::shared_ptr<InputRecorder> InputRecorder::create(const std::string& path, float sampleRate) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        WARN("Could not create input recording %s", path.c_str());
+        return nullptr;
+    }
+
+    RecordingHeader header;
+    std::memcpy(header.magic, RECORDING_MAGIC, sizeof(header.magic));
+    header.version = RECORDING_VERSION;
+    header.sampleRate = sampleRate;
+    header.numChannels = RECORDING_CHANNELS;
+    if (std::fwrite(&header, sizeof(header), 1, file) != 1) {
+        WARN("Could not write input recording %s", path.c_str());
+        std::fclose(file);
+        return nullptr;
+    }
+
+    std::shared_ptr<InputRecorder> recorder = std::make_shared<InputRecorder>();
+    recorder->file = file;
+    recorder->path = path;
+    return recorder;
+}
+
+void InputRecorder::drain() {
+    RecordingFrame frames[256];
+    size_t n = 0;
+    for (;;) {
+        bool popped = ring.pop(frames[n]);
+        if (popped)
+            n++;
+        if (n == 256 || (!popped && n > 0)) {
+            if (file && std::fwrite(frames, sizeof(RecordingFrame), n, file) == n) {
+                writtenFrames.fetch_add(n, std::memory_order_relaxed);
+            }
+            else if (file) {
+                WARN("Input recording %s: write failed, stopping", path.c_str());
+                std::fclose(file);
+                file = nullptr;
+                failed.store(true);
+                cancel();
+            }
+            n = 0;
+        }
+        if (!popped)
+            return;
+    }
+}
+
+void InputRecorder::run() {
+    drain();
+}
+
+void InputRecorder::close() {
+    // The module stops pushing and waits for the last tick first, so this is the tail
+    drain();
+    if (file) {
+        std::fclose(file);
+        file = nullptr;
+    }
+    INFO("Input recording %s: %llu frames, %u dropped", path.c_str(),
+         (unsigned long long) writtenFrames.load(), (unsigned) droppedFrames.load());
+}
+
+// ======= InputReplay =======
+
+InputReplay::~InputReplay() {
+    if (!mapping)
+        return;
+#if defined ARCH_WIN
+    delete[] (uint8_t*) mapping;
+#else
+    // Unmapping also unlocks
+    munmap(mapping, mappingSize);
+#endif
+}
+
+InputReplay* InputReplay::open(const std::string& path) {
+    void* mapping = nullptr;
+    size_t size = 0;
+
+#if defined ARCH_WIN
+    // No mmap: read the whole file instead
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (file) {
+        std::fseek(file, 0, SEEK_END);
+        long length = std::ftell(file);
+        std::fseek(file, 0, SEEK_SET);
+        if (length > 0) {
+            uint8_t* buffer = new uint8_t[length];
+            if (std::fread(buffer, 1, length, file) == (size_t) length) {
+                mapping = buffer;
+                size = length;
+            }
+            else {
+                delete[] buffer;
+            }
+        }
+        std::fclose(file);
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            int flags = MAP_PRIVATE;
+#if defined MAP_POPULATE
+            flags |= MAP_POPULATE;
+#endif
+            void* p = mmap(nullptr, st.st_size, PROT_READ, flags, fd, 0);
+            if (p != MAP_FAILED) {
+                mapping = p;
+                size = st.st_size;
+            }
+        }
+        // The mapping stays valid after the descriptor is closed
+        close(fd);
+    }
+#endif
+
+    if (!mapping) {
+        WARN("Could not open input recording %s", path.c_str());
+        return nullptr;
+    }
+
+    InputReplay* replay = new InputReplay;
+    replay->path = path;
+    replay->mapping = mapping;
+    replay->mappingSize = size;
+
+    RecordingHeader header;
+    if (size < sizeof(header)) {
+        WARN("Input recording %s is truncated", path.c_str());
+        delete replay;
+        return nullptr;
+    }
+    std::memcpy(&header, mapping, sizeof(header));
+    bool v1 = header.version == 1 && header.numChannels == RECORDING_CHANNELS_V1;
+    bool v2 = header.version == RECORDING_VERSION && header.numChannels == RECORDING_CHANNELS;
+    if (std::memcmp(header.magic, RECORDING_MAGIC, sizeof(header.magic)) != 0 || !(v1 || v2)) {
+        WARN("%s is not a Comparally input recording", path.c_str());
+        delete replay;
+        return nullptr;
+    }
+
+    replay->sampleRate = header.sampleRate;
+    replay->numChannels = header.numChannels;
+    replay->frames = (const float*) ((const uint8_t*) mapping + sizeof(header));
+    replay->numFrames = (size - sizeof(header)) / (header.numChannels * sizeof(float));
+    if (replay->numFrames == 0) {
+        WARN("Input recording %s has no frames", path.c_str());
+        delete replay;
+        return nullptr;
+    }
+
+#if !defined ARCH_WIN
+    // process() reads the frames, so no page may fault there: read ahead,
+    // touch every page now, and lock the file in RAM if RLIMIT_MEMLOCK
+    // allows (otherwise memory pressure could still evict clean pages)
+    madvise(mapping, size, MADV_WILLNEED);
+    long pageSize = sysconf(_SC_PAGESIZE);
+    volatile uint8_t sink = 0;
+    for (size_t offset = 0; offset < size; offset += pageSize) {
+        sink ^= ((const uint8_t*) mapping)[offset];
+    }
+    if (mlock(mapping, size) != 0)
+        INFO("Input recording %s: pages not locked, replay may fault under memory pressure", path.c_str());
+#endif
+    return replay;
+}
@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2025 ifnoon
+// Part of the ifnoon VCV Rack plugin project.
+
+/*
+ * InputRecording.hpp - Input Capture and Deterministic Replay
+ *
+ * Records the exact per-sample input a module's kernel sees to a raw
+ * binary file, and plays such a file back in place of the live inputs,
+ * so real patches can be profiled and regression-tested repeatably.
+ *
+ * File layout (native little-endian):
+ *   RecordingHeader (16 bytes), then float32 frames of numChannels values:
+ *   inputs A..D, SHIFT CVs A..D, SIZE CVs A..D, RESET, MORPH (NaN while
+ *   unpatched). Version 1 files end each frame after the SIZE CVs and
+ *   replay with RESET low and MORPH unpatched.
+ *
+ * - The audio thread only pushes frames into a lock-free ring; a periodic
+ *   job on the plugin's JobScheduler writes them to disk
+ * - Replay maps the file into memory (read into memory on Windows) and
+ *   faults every page in, locking them where the system allows, before
+ *   the audio thread reads it
+ */
+
+#pragma once
+
+#include "JobScheduler.hpp"
+#include "SpscQueue.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+static const int RECORDING_CHANNELS = 14;
+static const int RECORDING_CHANNELS_V1 = 12;
+static const uint32_t RECORDING_VERSION = 2;
+
+struct RecordingHeader {
+    char magic[4];          // "CMPR"
+    uint32_t version;
+    float sampleRate;
+    uint32_t numChannels;
+};
+
+struct RecordingFrame {
+    float values[RECORDING_CHANNELS];
+};
+
+// Milliseconds between two writer ticks; the ring holds several times that
+static const int RECORDER_PERIOD_MS = 50;
+
+// Periodic writer job: owns the file, each tick drains the ring
+struct InputRecorder : Job {
+    // 0.68 s of input at 48 kHz, 0.17 s at 192 kHz
+    SpscQueue<RecordingFrame, 32768> ring;
+    FILE* file = nullptr;
+    std::string path;
+    std::atomic<uint32_t> droppedFrames{0};
+    std::atomic<uint64_t> writtenFrames{0};
+    // A write failed: the file is closed and the job cancels itself
+    std::atomic<bool> failed{false};
+
+    ~InputRecorder();
+
+    // Creates the file and writes the header; nullptr on failure
+    static std::shared_ptr<InputRecorder> create(const std::string& path, float sampleRate);
+
+    // Audio thread: queues one frame, counting it as dropped if the ring is full
+    void push(const RecordingFrame& frame) {
+        if (!ring.push(frame))
+            droppedFrames.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // One tick: writes the queued frames
+    void run() override;
+    // After the job is done: writes the rest and closes the file
+    void close();
+
+private:
+    void drain();
+};
+
+// A recording opened for playback. Owned by the audio thread once handed
+// over; created and destroyed elsewhere.
+struct InputReplay {
+    std::string path;
+    float sampleRate = 0.f;
+    const float* frames = nullptr;
+    uint32_t numChannels = RECORDING_CHANNELS;
+    size_t numFrames = 0;
+    size_t pos = 0;
+
+    ~InputReplay();
+
+    // Maps, validates and pre-faults `path`; nullptr on failure
+    static InputReplay* open(const std::string& path);
+
+    // Next frame's numChannels values, looping at the end
+    const float* next() {
+        const float* frame = frames + pos * numChannels;
+        if (++pos >= numFrames)
+            pos = 0;
+        return frame;
+    }
+
+private:
+    // Mapping (or heap buffer) that `frames` points into
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+};
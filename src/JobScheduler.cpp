@@ -0,0 +1,254 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2025 ifnoon
+// Part of the ifnoon VCV Rack plugin project.
+
+/*
+ * JobScheduler.cpp - Plugin-Wide Worker Pool for Periodic Background Work
+ *
+ * A timer thread queues the ticks of periodic jobs when they fall due.
+ * Ticks wait in a queue guarded by the scheduler mutex; idle workers
+ * sleep on a condition variable that every queued tick notifies.
+ */
+
+#include "JobScheduler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <thread>
+#include <vector>
+
+// ======= Job =======
+
+void Job::cancel() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled.store(true, std::memory_order_release);
+    }
+    cv.notify_all();
+}
+
+void Job::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [this]() { return isDone(); });
+}
+
+void Job::finish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done.store(true, std::memory_order_release);
+    }
+    cv.notify_all();
+}
+
+void Job::drop() {
+    cancelled.store(true, std::memory_order_release);
+    done.store(true, std::memory_order_release);
+}
+
+// ======= Scheduler =======
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// Upper bound on the pool size, whatever the core count; the audio
+// engine's threads need the cores more
+const int MAX_JOB_WORKERS = 4;
+
+// Half the hardware threads, at least one
+int numJobWorkers() {
+    // hardware_concurrency() is 0 when unknown
+    int cores = (int) std::thread::hardware_concurrency();
+    return std::max(1, std::min(cores / 2, MAX_JOB_WORKERS));
+}
+
+// A job the timer thread runs every `period`
+struct PeriodicEntry {
+    std::shared_ptr<Job> job;
+    Clock::duration period;
+    Clock::time_point due;
+    // A tick is queued or running, so the next one is skipped
+    std::atomic<bool> busy{false};
+};
+
+// One run of a periodic job
+struct PeriodicTick : Job {
+    std::shared_ptr<PeriodicEntry> entry;
+
+    void run() override {
+        if (!entry->job->isCancelled())
+            entry->job->run();
+        entry->busy.store(false, std::memory_order_release);
+    }
+};
+
+struct JobScheduler {
+    // Guards everything below
+    std::mutex mutex;
+    bool running = false;
+    std::deque<std::shared_ptr<Job>> queue;
+
+    std::condition_variable wakeCv;
+    std::vector<std::thread> workers;
+    // Jobs currently inside run(), by worker, so stop() can cancel them
+    std::vector<std::shared_ptr<Job>> active;
+
+    std::condition_variable timerCv;
+    std::thread timer;
+    std::vector<std::shared_ptr<PeriodicEntry>> periodic;
+
+    void start() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (running)
+            return;
+        running = true;
+        int numWorkers = numJobWorkers();
+        active.resize(numWorkers);
+        for (int i = 0; i < numWorkers; i++) {
+            workers.push_back(std::thread([this, i]() { work(i); }));
+        }
+        timer = std::thread([this]() { tick(); });
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!running)
+                return;
+            running = false;
+            for (const std::shared_ptr<Job>& job : active) {
+                if (job)
+                    job->cancel();
+            }
+            for (const std::shared_ptr<PeriodicEntry>& entry : periodic) {
+                entry->job->cancel();
+            }
+        }
+        wakeCv.notify_all();
+        timerCv.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        timer.join();
+
+        // Only this thread is left: drop whatever never got to run
+        for (const std::shared_ptr<Job>& job : queue) {
+            job->cancel();
+            job->finish();
+        }
+        for (const std::shared_ptr<PeriodicEntry>& entry : periodic) {
+            entry->job->finish();
+        }
+        queue.clear();
+        periodic.clear();
+        workers.clear();
+        active.clear();
+    }
+
+    bool schedule(const std::shared_ptr<Job>& job, int periodMs) {
+        std::shared_ptr<PeriodicEntry> entry = std::make_shared<PeriodicEntry>();
+        entry->job = job;
+        entry->period = std::chrono::milliseconds(periodMs);
+        entry->due = Clock::now();
+        bool accepted;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            accepted = running;
+            if (accepted)
+                periodic.push_back(entry);
+        }
+        if (!accepted) {
+            job->drop();
+            return false;
+        }
+        timerCv.notify_one();
+        return true;
+    }
+
+    void work(int index) {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wakeCv.wait(lock, [this]() { return !queue.empty() || !running; });
+            if (!running)
+                return;
+            std::shared_ptr<Job> job = queue.front();
+            queue.pop_front();
+            active[index] = job;
+            lock.unlock();
+
+            if (!job->isCancelled())
+                job->run();
+            job->finish();
+
+            lock.lock();
+            active[index].reset();
+        }
+    }
+
+    // Timer thread: queues due ticks and retires cancelled periodic jobs
+    void tick() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (running) {
+            Clock::time_point now = Clock::now();
+            Clock::time_point wake = Clock::time_point::max();
+            for (size_t i = 0; i < periodic.size();) {
+                PeriodicEntry& entry = *periodic[i];
+                if (entry.busy.load(std::memory_order_acquire)) {
+                    // Still running: look again a period from now
+                    wake = std::min(wake, now + entry.period);
+                    i++;
+                    continue;
+                }
+                if (entry.job->isCancelled()) {
+                    entry.job->finish();
+                    periodic.erase(periodic.begin() + i);
+                    continue;
+                }
+                if (entry.due <= now) {
+                    std::shared_ptr<PeriodicTick> tick = std::make_shared<PeriodicTick>();
+                    tick->entry = periodic[i];
+                    entry.busy.store(true, std::memory_order_relaxed);
+                    entry.due = now + entry.period;
+                    queue.push_back(tick);
+                    wakeCv.notify_one();
+                }
+                wake = std::min(wake, entry.due);
+                i++;
+            }
+
+            if (wake == Clock::time_point::max())
+                timerCv.wait(lock);
+            else
+                timerCv.wait_until(lock, wake);
+        }
+    }
+};
+
+// Created by startJobScheduler() and destroyed by stopJobScheduler(),
+// never by a static destructor: joining threads during library unload can
+// deadlock under the Windows loader lock
+JobScheduler* scheduler = nullptr;
+
+}
+
+void startJobScheduler() {
+    if (!scheduler)
+        scheduler = new JobScheduler;
+    scheduler->start();
+}
+
+void stopJobScheduler() {
+    if (!scheduler)
+        return;
+    scheduler->stop();
+    delete scheduler;
+    scheduler = nullptr;
+}
+
+bool schedulePeriodicJob(const std::shared_ptr<Job>& job, int periodMs) {
+    if (!scheduler) {
+        job->drop();
+        return false;
+    }
+    return scheduler->schedule(job, periodMs);
+}
@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2025 ifnoon
+// Part of the ifnoon VCV Rack plugin project.
+
+/*
+ * JobScheduler.hpp - Plugin-Wide Worker Pool for Periodic Background Work
+ *
+ * A small pool of worker threads, started from init(), that runs periodic
+ * work too slow or too blocking for process(): writing recordings to disk,
+ * background input analysis.
+ * - schedulePeriodicJob() takes a mutex, so it is for the UI thread only,
+ *   never the audio thread. The audio thread only exchanges data with
+ *   jobs through lock-free queues (SpscQueue) and Handoffs.
+ * - Periodic work never holds a worker: a timer thread queues one run()
+ *   per period, skipping a tick while the previous one is still running
+ * - Jobs are cancellable; long-running jobs poll isCancelled()
+ * - Results go back to the audio thread through a Handoff (atomic
+ *   pointer swap); replaced values are freed off the audio thread
+ * - stopJobScheduler() cancels everything and joins the threads; the
+ *   plugin's destroy() calls it
+ */
+
+#pragma once
+
+#include "SpscQueue.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+struct Job {
+    virtual ~Job() {}
+
+    // Runs on a worker thread once per period. Should return soon after
+    // isCancelled() becomes true.
+    virtual void run() = 0;
+
+    void cancel();
+    bool isCancelled() const {
+        return cancelled.load(std::memory_order_acquire);
+    }
+    // True once the job will not run again: it was cancelled and its last
+    // tick finished, or it was dropped without running
+    bool isDone() const {
+        return done.load(std::memory_order_acquire);
+    }
+    // Blocks until isDone() (not from the audio thread)
+    void wait();
+
+    // Called by the scheduler
+    void finish();
+    // Called by the scheduler for a job it refused: flags the job cancelled
+    // and done without locking. Nobody can be waiting on it yet.
+    void drop();
+
+private:
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> done{false};
+    std::mutex mutex;
+    std::condition_variable cv;
+};
+
+// Starts the worker pool; called from init()
+void startJobScheduler();
+// Cancels queued, scheduled and running jobs and joins the threads;
+// called from the plugin's destroy()
+void stopJobScheduler();
+
+// Runs `job` on a worker every `periodMs` milliseconds, starting now,
+// until it is cancelled. Returns false (and drops the job) if the
+// scheduler is not running.
+bool schedulePeriodicJob(const std::shared_ptr<Job>& job, int periodMs);
+
+// Single-slot mailbox from one worker job to the audio thread.
+// The worker publishes freshly built values; the audio thread takes the
+// newest one and hands the value it replaces back through retire(), so
+// neither side ever frees memory on the audio thread.
+template <typename T>
+struct Handoff {
+    std::atomic<T*> pending{nullptr};
+    SpscQueue<T*, 16> retired;
+
+    ~Handoff() {
+        delete pending.exchange(nullptr);
+        collect();
+    }
+
+    // Worker: makes `value` the next value to take, freeing any value the
+    // audio thread has not taken yet and any retired ones
+    void publish(T* value) {
+        delete pending.exchange(value, std::memory_order_acq_rel);
+        collect();
+    }
+
+    // Audio thread: newest published value, or nullptr if none since the last take
+    T* take() {
+        if (!pending.load(std::memory_order_relaxed))
+            return nullptr;
+        return pending.exchange(nullptr, std::memory_order_acquire);
+    }
+
+    // Audio thread: returns a replaced value for freeing on the worker side.
+    // Leaks the value if 16 are already waiting, rather than block.
+    void retire(T* value) {
+        if (value)
+            retired.push(value);
+    }
+
+    // Worker: frees retired values
+    void collect() {
+        T* value;
+        while (retired.pop(value)) {
+            delete value;
+        }
+    }
+};
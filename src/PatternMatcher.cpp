@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2025 ifnoon
+// Part of the ifnoon VCV Rack plugin project.
+
+/*
+ * PatternMatcher.cpp - Event Sequence Detection over Packed Gate States
+ *
+ * Pattern compiler and the matcher's timeout bookkeeping.
+ */
+
+#include "PatternMatcher.hpp"
+#include <cctype>
+#include <cstdlib>
+#include <sstream>
+
+// Longest accepted step timeout, so deadlines stay well within 32 bits of samples
+static const float MAX_STEP_TIMEOUT = 60.f;
+
+static std::string toUpper(std::string s) {
+    for (char& c : s) {
+        c = std::toupper((unsigned char) c);
+    }
+    return s;
+}
+
+bool compilePattern(const std::string& text, const char* const* gateNames, int numGates,
+                    PatternProgram* program, std::string* error) {
+    PatternProgram result;
+
+    // Steps are separated by spaces or commas
+    std::string spaced = text;
+    for (char& c : spaced) {
+        if (c == ',')
+            c = ' ';
+    }
+    std::istringstream tokens(spaced);
+    std::string token;
+    while (tokens >> token) {
+        if (result.length >= PatternProgram::MAX_STEPS) {
+            *error = "More than 64 steps";
+            return false;
+        }
+        int step = result.length;
+
+        if (token[0] != '+' && token[0] != '-') {
+            *error = "\"" + token + "\": start each step with + or -";
+            return false;
+        }
+        bool rising = token[0] == '+';
+
+        std::string name = token.substr(1);
+        float timeout = 0.f;
+        size_t slash = name.find('/');
+        if (slash != std::string::npos) {
+            std::string ms = name.substr(slash + 1);
+            char* end = nullptr;
+            timeout = std::strtof(ms.c_str(), &end) / 1000.f;
+            if (ms.empty() || *end != '\0' || !(timeout > 0.f) || timeout > MAX_STEP_TIMEOUT) {
+                *error = "\"" + token + "\": timeout must be 1-60000 ms";
+                return false;
+            }
+            if (step == 0) {
+                *error = "\"" + token + "\": the first step can't have a timeout";
+                return false;
+            }
+            name = name.substr(0, slash);
+        }
+
+        name = toUpper(name);
+        int gate = -1;
+        for (int b = 0; b < numGates && b < PatternProgram::MAX_GATES; b++) {
+            if (name == gateNames[b]) {
+                gate = b;
+                break;
+            }
+        }
+        if (gate < 0) {
+            *error = "\"" + token + "\": unknown gate";
+            return false;
+        }
+
+        uint64_t stepBit = 1ull << step;
+        if (rising)
+            result.riseSteps[gate] |= stepBit;
+        else
+            result.fallSteps[gate] |= stepBit;
+        if (timeout > 0.f) {
+            // Timeout of step i is counted from the prefix ending at step i - 1
+            result.timeouts[step - 1] = timeout;
+            result.timedMask |= 1ull << (step - 1);
+        }
+        result.lastGate = gate;
+        result.lastRising = rising;
+        result.length++;
+    }
+
+    *program = result;
+    return true;
+}
+
+void PatternMatcher::setProgram(const PatternProgram* program, float sampleRate) {
+    this->program = program;
+    setSampleRate(sampleRate);
+    reset();
+}
+
+void PatternMatcher::setSampleRate(float sampleRate) {
+    if (!program)
+        return;
+    for (int j = 0; j < PatternProgram::MAX_STEPS; j++) {
+        timeoutSamples[j] = (uint32_t) (program->timeouts[j] * sampleRate);
+    }
+}
+
+void PatternMatcher::reset() {
+    active = 0;
+    nextDeadline = UINT64_MAX;
+}
+
+void PatternMatcher::expire() {
+    nextDeadline = UINT64_MAX;
+    if (!program)
+        return;
+    for (uint64_t timed = active & program->timedMask; timed; timed &= timed - 1) {
+        int j = __builtin_ctzll(timed);
+        if (deadlines[j] <= clock)
+            active &= ~(1ull << j);
+        else if (deadlines[j] < nextDeadline)
+            nextDeadline = deadlines[j];
+    }
+}
@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2025 ifnoon
+// Part of the ifnoon VCV Rack plugin project.
+
+/*
+ * PatternMatcher.hpp - Event Sequence Detection over Packed Gate States
+ *
+ * Patterns are sequences of gate edges, e.g. "+A_WIN +B_HI/50 -C_LO":
+ * A enters its window, then B goes HI within 50 ms, then C leaves LO.
+ * - Each step is [+|-]NAME[/MS]: rising (+) or falling (-) edge of the
+ *   named gate, optionally within MS milliseconds of the previous step
+ * - Up to 64 steps, compiled to a bit-parallel NFA (shift-and): bit i of
+ *   the active word means steps 0..i have occurred in order
+ * - A match clears all partial matches; the next one starts from step 0
+ * - Per sample the matcher costs a few bitwise ops per changed gate,
+ *   independent of the pattern length; timeouts are only scanned when
+ *   the earliest deadline passes
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+struct PatternProgram {
+    static const int MAX_STEPS = 64;
+    static const int MAX_GATES = 32;
+
+    // Steps advanced by a rising/falling edge of each gate bit
+    uint64_t riseSteps[MAX_GATES] = {};
+    uint64_t fallSteps[MAX_GATES] = {};
+    // timeouts[j]: seconds allowed between step j and step j + 1 (0 = none)
+    float timeouts[MAX_STEPS] = {};
+    uint64_t timedMask = 0;     // bit j set if timeouts[j] > 0
+    int length = 0;             // 0 = no pattern
+    // Gate and edge of the last step, for gate-mode output
+    int lastGate = 0;
+    bool lastRising = true;
+};
+
+// Parses `text` into `program`, naming gate bit b `gateNames[b]`
+// (case-insensitive). Returns false and sets `error` on a syntax error.
+bool compilePattern(const std::string& text, const char* const* gateNames, int numGates,
+                    PatternProgram* program, std::string* error);
+
+struct PatternMatcher {
+    const PatternProgram* program = nullptr;
+    uint64_t active = 0;
+    uint64_t clock = 0;                         // samples
+    uint64_t deadlines[PatternProgram::MAX_STEPS] = {};
+    uint64_t nextDeadline = UINT64_MAX;
+    uint32_t timeoutSamples[PatternProgram::MAX_STEPS] = {};
+
+    // Switches to `program` (may be nullptr) and clears all partial matches
+    void setProgram(const PatternProgram* program, float sampleRate);
+    void setSampleRate(float sampleRate);
+    void reset();
+
+    // Advances one sample given the gate bits that rose and fell.
+    // Returns true when the last step completes a match.
+    bool process(uint32_t rises, uint32_t falls) {
+        clock++;
+        if (clock >= nextDeadline)
+            expire();
+        if (!(rises | falls) || !program)
+            return false;
+
+        uint64_t events = 0;
+        for (uint32_t r = rises; r; r &= r - 1) {
+            events |= program->riseSteps[__builtin_ctz(r)];
+        }
+        for (uint32_t f = falls; f; f &= f - 1) {
+            events |= program->fallSteps[__builtin_ctz(f)];
+        }
+
+        // A step advances only from the previous step's prefix (or from the
+        // start), so one sample never advances a match by two steps
+        uint64_t advanced = ((active << 1) | 1) & events;
+        if (!advanced)
+            return false;
+        active |= advanced;
+
+        for (uint64_t timed = advanced & program->timedMask; timed; timed &= timed - 1) {
+            int j = __builtin_ctzll(timed);
+            deadlines[j] = clock + timeoutSamples[j];
+            if (deadlines[j] < nextDeadline)
+                nextDeadline = deadlines[j];
+        }
+
+        // A match consumes every partial match, so matches never overlap
+        if ((active >> (program->length - 1)) & 1) {
+            reset();
+            return true;
+        }
+        return false;
+    }
+
+private:
+    // Drops timed prefixes whose next step did not follow in time
+    void expire();
+};
@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2025 ifnoon
+// Part of the ifnoon VCV Rack plugin project.
+
+/*
+ * SpscQueue.hpp - Wait-Free Single-Producer/Single-Consumer Queue
+ *
+ * Fixed-capacity ring used to hand data from the audio thread to a
+ * background thread (or back) without locks or allocation:
+ * - push() and pop() never block and never allocate
+ * - push() fails instead of overwriting when the queue is full
+ * - Exactly one thread may push and exactly one thread may pop
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+template <typename T, size_t CAPACITY>
+struct SpscQueue {
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+    T items[CAPACITY];
+    // Producer and consumer indices kept on separate cache lines
+    std::atomic<size_t> tail{0};   // next slot to write, owned by the producer
+    char pad[64];
+    std::atomic<size_t> head{0};   // next slot to read, owned by the consumer
+
+    bool push(const T& item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) >= CAPACITY)
+            return false;
+        items[t & (CAPACITY - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+        item = items[h & (CAPACITY - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate when called from a third thread
+    size_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+};
@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2025 ifnoon
+// Part of the ifnoon VCV Rack plugin project.
+
+/*
+ * StateBlob.hpp - Compact Runtime State Serialization for ifnoon Modules
+ *
+ * Small little-endian writer/reader pair used to store a module's runtime
+ * state (latched gates, accumulators, counters) as one base64 string in
+ * the patch JSON instead of a tree of JSON values.
+ *
+ * Blobs are append-only and start with a version word: new fields go at
+ * the end with a version bump, and the module reads only the fields the
+ * stored version has. As a second guard the reader leaves destinations
+ * untouched when a truncated blob runs out of data.
+ */
+
+#pragma once
+
+#include "rack.hpp"
+#include <cstring>
+
+using namespace rack;
+
+struct StateBlobWriter {
+    std::vector<uint8_t> bytes;
+
+    void putU32(uint32_t v) {
+        for (int i = 0; i < 4; i++) {
+            bytes.push_back((v >> (8 * i)) & 0xff);
+        }
+    }
+
+    void putFloat(float v) {
+        uint32_t u;
+        std::memcpy(&u, &v, sizeof(u));
+        putU32(u);
+    }
+
+    void putFloat4(simd::float_4 v) {
+        for (int i = 0; i < 4; i++) {
+            putFloat(v[i]);
+        }
+    }
+
+    std::string toBase64() const {
+        return string::toBase64(bytes.data(), bytes.size());
+    }
+};
+
+struct StateBlobReader {
+    std::vector<uint8_t> bytes;
+    size_t pos = 0;
+
+    explicit StateBlobReader(const char* base64) {
+        if (!base64)
+            return;
+        try {
+            bytes = string::fromBase64(base64);
+        }
+        catch (std::exception& e) {
+            // Corrupt blob: behave like an empty one
+            bytes.clear();
+        }
+    }
+
+    bool getU32(uint32_t& v) {
+        if (pos + 4 > bytes.size())
+            return false;
+        v = 0;
+        for (int i = 0; i < 4; i++) {
+            v |= (uint32_t) bytes[pos++] << (8 * i);
+        }
+        return true;
+    }
+
+    bool getFloat(float& v) {
+        uint32_t u;
+        if (!getU32(u))
+            return false;
+        std::memcpy(&v, &u, sizeof(v));
+        return true;
+    }
+
+    bool getFloat4(simd::float_4& v) {
+        if (pos + 16 > bytes.size())
+            return false;
+        for (int i = 0; i < 4; i++) {
+            getFloat(v[i]);
+        }
+        return true;
+    }
+};
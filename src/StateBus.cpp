@@ -0,0 +1,14 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2025 ifnoon
+// Part of the ifnoon VCV Rack plugin project.
+
+/*
+ * StateBus.cpp - Cable-Free Sharing of Packed Gate States
+ *
+ * Storage for the bus slots; zero (all gates low, no publishers) until
+ * published to.
+ */
+
+#include "StateBus.hpp"
+
+BusSlot busSlots[NUM_BUS_SLOTS];
@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2025 ifnoon
+// Part of the ifnoon VCV Rack plugin project.
+
+/*
+ * StateBus.hpp - Cable-Free Sharing of Packed Gate States
+ *
+ * A fixed set of plugin-global slots through which module instances share
+ * their packed state word without patch cables:
+ * - Each slot fills its own cache line, so instances on different slots
+ *   never contend; the audio thread only does relaxed atomic loads/stores
+ * - A slot keeps the words of the two latest engine frames, and readers
+ *   take the previous frame's. A listener therefore sees exactly one
+ *   sample of latency, whatever order the engine runs the modules in.
+ * - With several publishers on one slot, the last write of a frame wins.
+ *   Publishers are counted per slot, and the slot is cleared only when
+ *   the last of them leaves.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+static const int NUM_BUS_SLOTS = 16;
+
+struct alignas(64) BusSlot {
+    std::atomic<uint32_t> words[2];
+    std::atomic<int> publishers;
+};
+
+extern BusSlot busSlots[NUM_BUS_SLOTS];
+
+// Audio thread: makes `word` the value of `slot` for engine frame `frame`
+inline void busPublish(int slot, int64_t frame, uint32_t word) {
+    busSlots[slot].words[frame & 1].store(word, std::memory_order_relaxed);
+}
+
+// Audio thread: the word published to `slot` one frame before `frame`
+inline uint32_t busRead(int slot, int64_t frame) {
+    return busSlots[slot].words[(frame - 1) & 1].load(std::memory_order_relaxed);
+}
+
+// Registers a publisher on `slot`
+inline void busJoin(int slot) {
+    busSlots[slot].publishers.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Unregisters a publisher from `slot`. The last one to leave clears it,
+// so listeners read low gates rather than its final word; a slot others
+// still publish to is left alone.
+inline void busLeave(int slot) {
+    if (busSlots[slot].publishers.fetch_sub(1, std::memory_order_relaxed) != 1)
+        return;
+    busSlots[slot].words[0].store(0, std::memory_order_relaxed);
+    busSlots[slot].words[1].store(0, std::memory_order_relaxed);
+}
+
+// Number of modules publishing to `slot`
+inline int busPublishers(int slot) {
+    return busSlots[slot].publishers.load(std::memory_order_relaxed);
+}
@@ -6,17 +6,28 @@
  * plugin.cpp - VCV Rack Plugin Entry Point for ifnoon Modules
  * 
  * This file contains the plugin initialization and module registration
- * for the ifnoon plugin collection including Comparally module.
+ * for the ifnoon plugin collection including Comparally module and its
+ * expander, and starts the shared job scheduler.
  */
 
 #include "plugin.hpp"
+#include "JobScheduler.hpp"
 
 Plugin* pluginInstance;
 
 void init(Plugin* p) {
     pluginInstance = p;
-    
-    // Register Comparally module
+
+    // Worker pool for non-realtime module work; stopped in destroy()
+    startJobScheduler();
+
+    // Register Comparally module and its expander
     p->addModel(modelComparally);
+    p->addModel(modelComparallyExpander);
 }
 
+// Called by Rack before the plugin library is unloaded, after every module
+// is gone; joins the workers while no loader lock is held
+extern "C" void destroy() {
+    stopJobScheduler();
+}
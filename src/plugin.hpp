@@ -18,4 +18,5 @@ using namespace rack;
 
 extern Plugin* pluginInstance;
 extern Model* modelComparally;
+extern Model* modelComparallyExpander;
 extern Model* modelMatho;
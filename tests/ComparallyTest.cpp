@@ -0,0 +1,516 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2025 ifnoon
+// Part of the ifnoon VCV Rack plugin project.
+
+/*
+ * ComparallyTest.cpp - Behaviour Tests for the Comparally Module
+ *
+ * Runs Comparally headless: inputs are written and process() is called
+ * directly, the way the engine would. The module source is included here
+ * so the tests can reach its internals; the test build leaves
+ * Comparally.cpp out of its source list.
+ */
+
+#include "test.hpp"
+#include "Comparally.cpp"
+
+namespace {
+
+const float SAMPLE_RATE = 48000.f;
+
+// A headless Comparally with its expander linked on the right, the four
+// signal inputs and every output of both patched
+struct Rig {
+    Comparally module;
+    ComparallyExpander expander;
+    int64_t frame = 0;
+
+    Rig() {
+        for (int c = 0; c < 4; c++) {
+            module.inputs[Comparally::A_IN_INPUT + 3 * c].channels = 1;
+        }
+        for (engine::Output& output : module.outputs) {
+            output.channels = 1;
+        }
+        for (engine::Output& output : expander.outputs) {
+            output.channels = 1;
+        }
+        module.model = modelComparally;
+        expander.model = modelComparallyExpander;
+        module.rightExpander.module = &expander;
+        expander.leftExpander.module = &module;
+        Module::SampleRateChangeEvent e;
+        e.sampleRate = SAMPLE_RATE;
+        e.sampleTime = 1.f / SAMPLE_RATE;
+        module.onSampleRateChange(e);
+    }
+
+    void setInputs(float a, float b, float c, float d) {
+        module.inputs[Comparally::A_IN_INPUT].setVoltage(a);
+        module.inputs[Comparally::B_IN_INPUT].setVoltage(b);
+        module.inputs[Comparally::C_IN_INPUT].setVoltage(c);
+        module.inputs[Comparally::D_IN_INPUT].setVoltage(d);
+    }
+
+    // Swaps an expander's message buffers, as the engine does after a frame
+    static void flip(Module::Expander& side) {
+        if (!side.messageFlipRequested)
+            return;
+        std::swap(side.producerMessage, side.consumerMessage);
+        side.messageFlipRequested = false;
+    }
+
+    void step(int frames = 1) {
+        Module::ProcessArgs args;
+        args.sampleRate = SAMPLE_RATE;
+        args.sampleTime = 1.f / SAMPLE_RATE;
+        for (int i = 0; i < frames; i++) {
+            args.frame = frame++;
+            module.process(args);
+            expander.process(args);
+            flip(module.rightExpander);
+            flip(expander.leftExpander);
+        }
+    }
+
+    float voltage(int outputId, int channel = 0) {
+        return module.outputs[outputId].getVoltage(channel);
+    }
+
+    float expanderVoltage(int outputId, int channel = 0) {
+        return expander.outputs[outputId].getVoltage(channel);
+    }
+};
+
+} // namespace
+
+TEST(comparallyStateRoundTrip) {
+    // Default windows are 0 V +-0.5 V: A HI, B WIN, C LO, D WIN
+    Rig rig;
+    rig.setInputs(3.f, 0.f, -3.f, 0.2f);
+    rig.step(100);
+    rig.setInputs(3.f, 0.f, -3.f, 3.f);
+    rig.step(10);
+
+    json_t* rootJ = rig.module.dataToJson();
+    Rig loaded;
+    loaded.module.dataFromJson(rootJ);
+    json_decref(rootJ);
+
+    CHECK(loaded.module.kernelState == rig.module.kernelState);
+    CHECK(loaded.module.state == rig.module.state);
+    CHECK(loaded.module.rawWinBits == rig.module.rawWinBits);
+    for (int c = 0; c < 4; c++) {
+        CHECK(loaded.module.dwellSamples[c] == rig.module.dwellSamples[c]);
+        CHECK(loaded.module.winDuty[c] == rig.module.winDuty[c]);
+        CHECK(loaded.module.entryCounts[c] == rig.module.entryCounts[c]);
+    }
+    // D crossed into HI on the first of the last 10 samples
+    CHECK(loaded.module.dwellSamples[3] == 9);
+}
+
+TEST(comparallyStateOldBlob) {
+    // A version 1 blob restores the gates and leaves later fields alone
+    StateBlobWriter writer;
+    writer.putU32(1);
+    writer.putU32(1u << Comparally::HI_BIT);
+    writer.putFloat4(7.f);
+    json_t* rootJ = json_object();
+    json_object_set_new(rootJ, "state", json_string(writer.toBase64().c_str()));
+
+    Rig rig;
+    rig.module.dataFromJson(rootJ);
+    json_decref(rootJ);
+    CHECK(rig.module.kernelState == 1u << Comparally::HI_BIT);
+    CHECK(rig.module.shiftCvSmooth[0] == 0.f);
+}
+
+TEST(comparallyPatternMatch) {
+    Rig rig;
+    rig.module.setPattern("+A_WIN +A_HI/1");
+    rig.setInputs(-3.f, 0.f, 0.f, 0.f);
+    rig.step(10);
+    CHECK(rig.module.matchTimer <= 0.f);
+
+    // A enters its window, then goes HI within 1 ms: one match
+    rig.setInputs(0.f, 0.f, 0.f, 0.f);
+    rig.step(10);
+    rig.setInputs(3.f, 0.f, 0.f, 0.f);
+    rig.step();
+    CHECK(rig.module.matchTimer > 0.f);
+
+    // Too slow the second time: 2 ms between the steps
+    rig.setInputs(-3.f, 0.f, 0.f, 0.f);
+    rig.step(100);
+    rig.setInputs(0.f, 0.f, 0.f, 0.f);
+    rig.step(96);
+    rig.setInputs(3.f, 0.f, 0.f, 0.f);
+    rig.step();
+    CHECK(rig.module.matchTimer <= 0.f);
+}
+
+TEST(comparallyExpanderLink) {
+    Rig rig;
+    rig.setInputs(0.f, 0.f, 0.f, 0.f);
+    rig.step(10);
+    // S&H latched the inputs on entry; the expander shows Comparally's
+    // rendering of the previous sample
+    CHECK(rig.module.expansionOutputs[ComparallyExpander::SH_OUTPUT].getChannels() == 4);
+    CHECK(rig.expander.outputs[ComparallyExpander::SH_OUTPUT].getChannels() == 4);
+    CHECK(rig.expanderVoltage(ComparallyExpander::DUTY_OUTPUT) > 0.f);
+
+    // An unpatched expander output is unpatched on the Comparally side too
+    rig.expander.outputs[ComparallyExpander::PASS_OUTPUT].channels = 0;
+    rig.step(2);
+    CHECK(!rig.module.expansionOutputs[ComparallyExpander::PASS_OUTPUT].isConnected());
+
+    // RESET on the expander reaches the counters one sample later
+    rig.module.params[Comparally::A_DIVISION_PARAM].setValue(4.f);
+    rig.setInputs(3.f, 3.f, 3.f, 3.f);
+    rig.step(2);
+    rig.setInputs(0.f, 0.f, 0.f, 0.f);
+    rig.step(2);
+    CHECK(rig.module.entryCounts[0] != 0);
+    rig.expander.inputs[ComparallyExpander::RESET_INPUT].channels = 1;
+    rig.expander.inputs[ComparallyExpander::RESET_INPUT].setVoltage(10.f);
+    rig.step();
+    CHECK(rig.module.entryCounts[0] != 0);
+    rig.step();
+    CHECK(rig.module.entryCounts[0] == 0);
+
+    // Unlinked: the expander reads 0 V and Comparally sees nothing patched
+    rig.module.rightExpander.module = nullptr;
+    rig.expander.leftExpander.module = nullptr;
+    rig.step(2);
+    CHECK(rig.expanderVoltage(ComparallyExpander::DUTY_OUTPUT) == 0.f);
+    CHECK(!rig.module.expansionOutputs[ComparallyExpander::DUTY_OUTPUT].isConnected());
+}
+
+TEST(comparallyDelayIsSampleExact) {
+    // A WIN pulse on A over samples 10-12 comes out of DELAY over samples
+    // 110-112: 100 samples later, still 3 samples long, with LO clear
+    Rig rig;
+    rig.module.params[Comparally::DELAY_PARAM].setValue(100.f / SAMPLE_RATE);
+    rig.setInputs(-3.f, -3.f, -3.f, -3.f);
+    rig.step(10);
+    rig.setInputs(0.f, -3.f, -3.f, -3.f);
+    rig.step(3);
+    rig.setInputs(-3.f, -3.f, -3.f, -3.f);
+
+    engine::Output& delayed = rig.module.expansionOutputs[ComparallyExpander::DELAY_OUTPUT];
+    int firstHigh = -1;
+    int highSamples = 0;
+    for (int i = 0; i < 120; i++) {
+        rig.step();
+        // Channels: HI A..D, WIN A..D, LO A..D
+        bool win = delayed.getVoltage(4) > 5.f;
+        if (win) {
+            if (firstHigh < 0)
+                firstHigh = i;
+            highSamples++;
+            CHECK(delayed.getVoltage(8) < 5.f);
+        }
+    }
+    // The loop starts at sample 13
+    CHECK(firstHigh == 110 - 13);
+    CHECK(highSamples == 3);
+}
+
+TEST(comparallyCvDividerRampsEdges) {
+    // At a CV rate of 8, a SHIFT CV step moves A's edges 1 V per sample,
+    // starting at the next divider tick and ending 8 samples later
+    Rig rig;
+    rig.module.cvDivider = 8;
+    rig.module.inputs[Comparally::A_SHIFT_CV_INPUT].channels = 1;
+    rig.step(16);
+    CHECK(rig.module.cvHiEdge[0] == 0.5f);
+    CHECK(rig.module.cvLoEdge[0] == -0.5f);
+
+    rig.module.inputs[Comparally::A_SHIFT_CV_INPUT].setVoltage(8.f);
+    for (int k = 1; k <= 12; k++) {
+        rig.step();
+        float moved = (float) std::min(k, 8);
+        CHECK(rig.module.cvHiEdge[0] == 0.5f + moved);
+        CHECK(rig.module.cvLoEdge[0] == -0.5f + moved);
+    }
+}
+
+TEST(comparallyPitchModeGatesWin) {
+    // A matches only C: C (0 V) opens WIN, D (2/12 V) is inside the
+    // window but off the scale. Non-finite input reads as C.
+    Rig rig;
+    rig.module.scaleMasks[0] = 0x001;
+    rig.module.publishPitchTables();
+    rig.module.setPitchMode(0, true);
+    rig.setInputs(0.f, 0.f, 0.f, 0.f);
+    rig.step(2);
+    CHECK((rig.module.kernelState >> Comparally::WIN_BIT) & 1);
+    rig.setInputs(2.f / 12.f, 0.f, 0.f, 0.f);
+    rig.step(2);
+    CHECK(!((rig.module.kernelState >> Comparally::WIN_BIT) & 1));
+    CHECK((rig.module.rawWinBits & 1) != 0);
+
+    rig.setInputs(NAN, 0.f, 0.f, 0.f);
+    rig.step(2);
+    rig.setInputs(INFINITY, 0.f, 0.f, 0.f);
+    rig.step(2);
+    CHECK((rig.module.pitchMatchBits & 1) != 0);
+}
+
+TEST(comparallySampleHoldModes) {
+    // A latches on entry (default), B on exit, C on entry and exit, D on
+    // any HI/WIN/LO change. All four go LO -> WIN -> HI.
+    Rig rig;
+    rig.module.setSampleHoldMode(1, Comparally::SH_ON_EXIT);
+    rig.module.setSampleHoldMode(2, Comparally::SH_ON_ENTER_EXIT);
+    rig.module.setSampleHoldMode(3, Comparally::SH_ON_ANY_CHANGE);
+    engine::Output& held = rig.module.expansionOutputs[ComparallyExpander::SH_OUTPUT];
+
+    rig.setInputs(-3.f, -3.f, -3.f, -3.f);
+    rig.step(10);
+    rig.setInputs(0.2f, 0.2f, 0.2f, 0.2f);
+    rig.step();
+    CHECK(held.getVoltage(0) == 0.2f);
+    CHECK(held.getVoltage(1) == 0.f);
+    CHECK(held.getVoltage(2) == 0.2f);
+    CHECK(held.getVoltage(3) == 0.2f);
+
+    // Moving inside the window latches nothing
+    rig.setInputs(0.3f, 0.3f, 0.3f, 0.3f);
+    rig.step(10);
+    CHECK(held.getVoltage(0) == 0.2f);
+    CHECK(held.getVoltage(3) == 0.2f);
+
+    rig.setInputs(3.f, 3.f, 3.f, 3.f);
+    rig.step();
+    CHECK(held.getVoltage(0) == 0.2f);
+    CHECK(held.getVoltage(1) == 3.f);
+    CHECK(held.getVoltage(2) == 3.f);
+    CHECK(held.getVoltage(3) == 3.f);
+
+    // HI -> LO without entering: only "any change" latches
+    rig.setInputs(-3.f, -3.f, -3.f, -3.f);
+    rig.step();
+    CHECK(held.getVoltage(0) == 0.2f);
+    CHECK(held.getVoltage(1) == 3.f);
+    CHECK(held.getVoltage(2) == 3.f);
+    CHECK(held.getVoltage(3) == -3.f);
+}
+
+TEST(comparallyEdgeTriggers) {
+    // A goes LO -> WIN with B already in WIN: WIN A rises, LO A falls,
+    // A+B AND rises and A+B XOR falls, each for 1 ms (48 samples)
+    Rig rig;
+    engine::Output& rise = rig.module.expansionOutputs[ComparallyExpander::RISE_OUTPUT];
+    engine::Output& fall = rig.module.expansionOutputs[ComparallyExpander::FALL_OUTPUT];
+    engine::Output& logicRise = rig.module.expansionOutputs[ComparallyExpander::LOGIC_RISE_OUTPUT];
+    engine::Output& logicFall = rig.module.expansionOutputs[ComparallyExpander::LOGIC_FALL_OUTPUT];
+    rig.setInputs(-3.f, 0.f, -3.f, -3.f);
+    rig.step(100);
+    CHECK(rise.getChannels() == 12);
+    CHECK(logicRise.getChannels() == Comparally::NUM_STATE_BITS - 12);
+    CHECK(rise.getVoltage(4) == 0.f);
+
+    rig.setInputs(0.f, 0.f, -3.f, -3.f);
+    int riseSamples = 0;
+    for (int i = 0; i < 100; i++) {
+        rig.step();
+        // Channels: HI A..D, WIN A..D, LO A..D; logic A+B AND, OR, XOR, FF, ...
+        if (rise.getVoltage(4) == 10.f) {
+            riseSamples++;
+            CHECK(fall.getVoltage(8) == 10.f);
+            CHECK(logicRise.getVoltage(0) == 10.f);
+            CHECK(logicFall.getVoltage(2) == 10.f);
+        }
+        CHECK(rise.getVoltage(5) == 0.f);
+        CHECK(logicRise.getVoltage(1) == 0.f);
+    }
+    CHECK(riseSamples >= 47 && riseSamples <= 49);
+
+    // The Expansion group's levels apply, swapped when inverted
+    rig.module.params[Comparally::EXPANSION_HIGH_PARAM].setValue(5.f);
+    rig.module.params[Comparally::EXPANSION_LOW_PARAM].setValue(-5.f);
+    rig.module.outputInverted[Comparally::GROUP_EXPANSION] = true;
+    rig.setInputs(3.f, 0.f, -3.f, -3.f);
+    rig.step();
+    CHECK(rise.getVoltage(0) == -5.f);
+    CHECK(fall.getVoltage(4) == -5.f);
+    CHECK(rise.getVoltage(4) == 5.f);
+
+    // Unpatched outputs drop their pending pulses: re-patching after an
+    // edge does not fire a stale trigger
+    rig.module.outputInverted[Comparally::GROUP_EXPANSION] = false;
+    rig.step(100);
+    rig.expander.outputs[ComparallyExpander::RISE_OUTPUT].channels = 0;
+    rig.expander.outputs[ComparallyExpander::FALL_OUTPUT].channels = 0;
+    rig.step(2);
+    rig.setInputs(0.f, 0.f, -3.f, -3.f);
+    rig.step();
+    rig.expander.outputs[ComparallyExpander::RISE_OUTPUT].channels = 1;
+    rig.expander.outputs[ComparallyExpander::FALL_OUTPUT].channels = 1;
+    rig.step(2);
+    CHECK(rise.getVoltage(4) == -5.f);
+    CHECK(fall.getVoltage(0) == -5.f);
+}
+
+TEST(comparallyBlockModeLatency) {
+    // Block mode gives the per-sample gates exactly blockSize samples late,
+    // and a block-size change mid-stream drops no transition
+    Rig reference;
+    Rig blocked;
+    blocked.module.blockSize = 16;
+    std::vector<float> expected[4];
+    int referenceEntries = 0;
+    int blockedEntries = 0;
+    bool referenceWin = false;
+    bool blockedWin = false;
+    for (int i = 0; i < 600; i++) {
+        float x = 2.f * std::sin(0.05f * i);
+        if (i >= 400)
+            x = 3.f;    // settle HI so the last block drains
+        reference.setInputs(x, -x, 0.5f * x, 0.f);
+        blocked.setInputs(x, -x, 0.5f * x, 0.f);
+        if (i == 250)
+            blocked.module.blockSize = 8;
+        reference.step();
+        blocked.step();
+
+        for (int c = 0; c < 4; c++) {
+            expected[c].push_back(reference.voltage(Comparally::A_WIN_OUTPUT + 3 * c));
+            if (i < 250 && i >= 16)
+                CHECK(blocked.voltage(Comparally::A_WIN_OUTPUT + 3 * c) == expected[c][i - 16]);
+            if (i > 260)
+                CHECK(blocked.voltage(Comparally::A_WIN_OUTPUT + 3 * c) == expected[c][i - 8]);
+        }
+        bool win = reference.voltage(Comparally::A_WIN_OUTPUT) > 5.f;
+        referenceEntries += win && !referenceWin;
+        referenceWin = win;
+        win = blocked.voltage(Comparally::A_WIN_OUTPUT) > 5.f;
+        blockedEntries += win && !blockedWin;
+        blockedWin = win;
+    }
+    CHECK(blocked.module.getLatency() == 8);
+    CHECK(referenceEntries > 4);
+    CHECK(blockedEntries == referenceEntries);
+}
+
+TEST(comparallyEntryCounters) {
+    // A divides by 3, B by 1: A's DIV passes entries 1, 4 and 7, B's every
+    // entry; COUNT steps 10 V / N per entry and wraps
+    Rig rig;
+    rig.module.params[Comparally::A_DIVISION_PARAM].setValue(3.f);
+    rig.module.params[Comparally::B_DIVISION_PARAM].setValue(1.f);
+    engine::Output& divided = rig.module.expansionOutputs[ComparallyExpander::DIV_OUTPUT];
+    engine::Output& count = rig.module.expansionOutputs[ComparallyExpander::COUNT_OUTPUT];
+    rig.setInputs(-3.f, -3.f, -3.f, -3.f);
+    rig.step(10);
+    for (int entry = 1; entry <= 7; entry++) {
+        rig.setInputs(0.f, 0.f, -3.f, -3.f);
+        rig.step(5);
+        bool passed = (entry % 3) == 1;
+        CHECK((divided.getVoltage(0) == 10.f) == passed);
+        CHECK(divided.getVoltage(1) == 10.f);
+        CHECK(std::fabs(count.getVoltage(0) - 10.f * (entry % 3) / 3.f) < 1e-5f);
+        CHECK(count.getVoltage(1) == 0.f);
+
+        // DIV follows WIN: low again outside the window
+        rig.setInputs(-3.f, -3.f, -3.f, -3.f);
+        rig.step(5);
+        CHECK(divided.getVoltage(0) == 0.f);
+        CHECK(divided.getVoltage(1) == 0.f);
+    }
+    CHECK(rig.module.entryCounts[0] == 1);
+}
+
+TEST(comparallySnapshotMorph) {
+    // Two snapshots: A's window at 0 V, then at 4 V. MORPH on the expander
+    // sweeps A's center between them; unpatched, the knobs apply again.
+    Rig rig;
+    rig.module.storeSnapshot(0);
+    rig.module.params[Comparally::A_SHIFT_PARAM].setValue(4.f);
+    rig.module.storeSnapshot(1);
+    rig.module.params[Comparally::A_SHIFT_PARAM].setValue(0.f);
+    engine::Input& morph = rig.expander.inputs[ComparallyExpander::MORPH_INPUT];
+    morph.channels = 1;
+
+    rig.setInputs(2.f, 0.f, 0.f, 0.f);
+    morph.setVoltage(0.f);
+    rig.step(3);
+    CHECK(rig.module.morphShift[0] == 0.f);
+    CHECK((rig.module.kernelState >> Comparally::HI_BIT) & 1);
+
+    morph.setVoltage(5.f);
+    rig.step(3);
+    CHECK(rig.module.morphShift[0] == 2.f);
+    CHECK((rig.module.kernelState >> Comparally::WIN_BIT) & 1);
+
+    morph.setVoltage(10.f);
+    rig.step(3);
+    CHECK(rig.module.morphShift[0] == 4.f);
+    CHECK((rig.module.kernelState >> Comparally::LO_BIT) & 1);
+
+    // The snapshots are saved with the patch
+    json_t* rootJ = rig.module.dataToJson();
+    Rig loaded;
+    loaded.module.dataFromJson(rootJ);
+    json_decref(rootJ);
+    CHECK(loaded.module.snapshots.count == 2);
+    CHECK(loaded.module.snapshots.shift[1][0] == 4.f);
+
+    morph.channels = 0;
+    rig.step(3);
+    CHECK((rig.module.kernelState >> Comparally::HI_BIT) & 1);
+}
+
+TEST(comparallyStateBus) {
+    // `source` publishes to slot 3, `listener` combines it with its own
+    // WIN gates. The listener sees the source one sample late.
+    Rig source;
+    Rig listener;
+    source.module.busPublishSlot = 3;
+    listener.module.busListenSlot = 3;
+    engine::Output& bus = listener.module.expansionOutputs[ComparallyExpander::BUS_OUTPUT];
+    auto step = [&]() {
+        source.step();
+        listener.step();
+    };
+    source.setInputs(0.f, -3.f, -3.f, -3.f);
+    listener.setInputs(0.f, 0.f, -3.f, -3.f);
+    step();
+    step();
+    CHECK(busPublishers(3) == 1);
+    // Channels: AND A..D, OR A..D, XOR A..D
+    CHECK(bus.getVoltage(0) == 10.f);
+    CHECK(bus.getVoltage(1) == 0.f);
+    CHECK(bus.getVoltage(5) == 10.f);
+    CHECK(bus.getVoltage(9) == 10.f);
+
+    source.setInputs(-3.f, -3.f, -3.f, -3.f);
+    step();
+    CHECK(bus.getVoltage(0) == 10.f);
+    step();
+    CHECK(bus.getVoltage(0) == 0.f);
+    CHECK(bus.getVoltage(8) == 10.f);
+
+    {
+        // A second publisher, as after duplicating `source`, keeps the
+        // slot alive when the first moves away
+        Rig copy;
+        copy.frame = source.frame;
+        copy.module.busPublishSlot = 3;
+        copy.setInputs(0.f, -3.f, -3.f, -3.f);
+        copy.step();
+        CHECK(busPublishers(3) == 2);
+        source.module.busPublishSlot = -1;
+        step();
+        CHECK(busPublishers(3) == 1);
+        copy.step();
+        step();
+        CHECK(bus.getVoltage(0) == 10.f);
+    }
+    // The last publisher is gone: the slot reads low
+    CHECK(busPublishers(3) == 0);
+    step();
+    CHECK(bus.getVoltage(0) == 0.f);
+    CHECK(busRead(3, listener.frame) == 0);
+}
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2025 ifnoon
+// Part of the ifnoon VCV Rack plugin project.
+
+/*
+ * InputAnalysisTest.cpp - Tests for the Background Input Statistics
+ */
+
+#include "test.hpp"
+#include "InputAnalysis.hpp"
+
+TEST(logHistogramPercentiles) {
+    // Uniform -5..5 V: percentiles land within a log bin of the true value
+    LogHistogram histogram;
+    for (int i = 0; i < 1000; i++) {
+        histogram.add(-5.f + 10.f * (i + 0.5f) / 1000.f);
+    }
+    CHECK(histogram.total == 1000.f);
+    float low = histogram.percentile(0.1f);
+    float high = histogram.percentile(0.9f);
+    CHECK(low > -4.4f && low < -3.6f);
+    CHECK(high > 3.6f && high < 4.4f);
+    CHECK(std::fabs(histogram.percentile(0.5f)) < 0.05f);
+
+    histogram.clear();
+    CHECK(histogram.total == 0.f);
+    CHECK(histogram.percentile(0.5f) == 0.f);
+}
+
+TEST(analysisFeedSuggestions) {
+    AnalysisFeed feed;
+    WindowSuggestion suggestions[AnalysisFeed::NUM_SUGGESTIONS];
+    CHECK(!feed.getSuggestions(0, suggestions));
+
+    // Channel A sweeps 1..3 V, the others sit at 0 V
+    for (int i = 0; i < 1024; i++) {
+        CHECK(feed.samples.push(simd::float_4(1.f + 2.f * (i % 256) / 255.f, 0.f, 0.f, 0.f)));
+        if (i % 512 == 511)
+            feed.analyze();
+    }
+    CHECK(feed.getSuggestions(0, suggestions));
+    for (int i = 0; i < AnalysisFeed::NUM_SUGGESTIONS; i++) {
+        CHECK(suggestions[i].lo >= 0.9f && suggestions[i].hi <= 3.3f);
+        CHECK(suggestions[i].lo < suggestions[i].hi);
+    }
+    // Narrower bands nest inside wider ones
+    CHECK(suggestions[3].lo >= suggestions[0].lo && suggestions[3].hi <= suggestions[0].hi);
+
+    // A reset drops what was learned at the next pass
+    feed.resetRequested = true;
+    feed.samples.push(0.f);
+    feed.analyze();
+    CHECK(!feed.getSuggestions(0, suggestions));
+}
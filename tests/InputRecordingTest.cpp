@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2025 ifnoon
+// Part of the ifnoon VCV Rack plugin project.
+
+/*
+ * InputRecordingTest.cpp - Tests for Input Recording and Replay Files
+ */
+
+#include "test.hpp"
+#include "plugin.hpp"
+#include "InputRecording.hpp"
+#include <cmath>
+
+static const char* const TEST_RECORDING = "InputRecordingTest.cmpr";
+
+TEST(inputRecordingRoundTrip) {
+    // Frames written by the recorder replay in order, RESET and MORPH
+    // included, and loop at the end
+    std::shared_ptr<InputRecorder> recorder = InputRecorder::create(TEST_RECORDING, 48000.f);
+    CHECK(recorder != nullptr);
+    if (!recorder)
+        return;
+    for (int i = 0; i < 3; i++) {
+        RecordingFrame frame;
+        for (int v = 0; v < RECORDING_CHANNELS; v++) {
+            frame.values[v] = i * 100.f + v;
+        }
+        frame.values[13] = (i == 1) ? NAN : 5.f;
+        recorder->push(frame);
+    }
+    recorder->close();
+    CHECK(recorder->writtenFrames.load() == 3);
+
+    InputReplay* replay = InputReplay::open(TEST_RECORDING);
+    CHECK(replay != nullptr);
+    if (replay) {
+        CHECK(replay->sampleRate == 48000.f);
+        CHECK(replay->numChannels == RECORDING_CHANNELS);
+        CHECK(replay->numFrames == 3);
+        for (int i = 0; i < 4; i++) {
+            const float* values = replay->next();
+            CHECK(values[0] == (i % 3) * 100.f);
+            CHECK(values[12] == (i % 3) * 100.f + 12.f);
+            CHECK(std::isnan(values[13]) == (i % 3 == 1));
+        }
+        delete replay;
+    }
+    std::remove(TEST_RECORDING);
+}
+
+TEST(inputRecordingVersion1) {
+    // A version 1 file has 12 channels per frame and still opens
+    FILE* file = std::fopen(TEST_RECORDING, "wb");
+    CHECK(file != nullptr);
+    if (!file)
+        return;
+    RecordingHeader header = {{'C', 'M', 'P', 'R'}, 1, 44100.f, RECORDING_CHANNELS_V1};
+    std::fwrite(&header, sizeof(header), 1, file);
+    float values[2 * RECORDING_CHANNELS_V1];
+    for (int v = 0; v < 2 * RECORDING_CHANNELS_V1; v++) {
+        values[v] = (float) v;
+    }
+    std::fwrite(values, sizeof(values), 1, file);
+    std::fclose(file);
+
+    InputReplay* replay = InputReplay::open(TEST_RECORDING);
+    CHECK(replay != nullptr);
+    if (replay) {
+        CHECK(replay->numChannels == RECORDING_CHANNELS_V1);
+        CHECK(replay->numFrames == 2);
+        replay->next();
+        CHECK(replay->next()[0] == (float) RECORDING_CHANNELS_V1);
+        delete replay;
+    }
+
+    // An unknown version is refused
+    header.version = 3;
+    file = std::fopen(TEST_RECORDING, "wb");
+    std::fwrite(&header, sizeof(header), 1, file);
+    std::fwrite(values, sizeof(values), 1, file);
+    std::fclose(file);
+    CHECK(InputReplay::open(TEST_RECORDING) == nullptr);
+    std::remove(TEST_RECORDING);
+}
@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2025 ifnoon
+// Part of the ifnoon VCV Rack plugin project.
+
+/*
+ * MedianFilterTest.cpp - Tests for the Four-Lane Sliding Median
+ */
+
+#include "test.hpp"
+#include "MedianFilter.hpp"
+#include <random>
+
+// Median of the last `length` inputs, by sorting a copy
+static float referenceMedian(const std::vector<float>& history, int length) {
+    std::vector<float> window(history.end() - length, history.end());
+    std::sort(window.begin(), window.end());
+    return window[length / 2];
+}
+
+TEST(medianFilterRejectsSpikes) {
+    // A single-sample spike never gets through a median of 3 or more
+    MedianFilter filter;
+    int lengths[4] = {3, 5, 1, 9};
+    filter.setLengths(lengths);
+    CHECK(filter.active);
+    for (int i = 0; i < 32; i++) {
+        simd::float_4 out = filter.process((i == 20) ? 10.f : 0.f);
+        CHECK(out[0] == 0.f);
+        CHECK(out[1] == 0.f);
+        CHECK(out[2] == ((i == 20) ? 10.f : 0.f));
+        CHECK(out[3] == 0.f);
+    }
+}
+
+TEST(medianFilterMatchesReference) {
+    // Every lane against a sorted reference, on random input with length
+    // changes mid-stream; a longer window is refilled from the ring at once
+    MedianFilter filter;
+    std::vector<float> history[4];
+    for (int i = 0; i < MedianFilter::RING_SIZE; i++) {
+        filter.process(0.f);
+        for (int c = 0; c < 4; c++) {
+            history[c].push_back(0.f);
+        }
+    }
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> uniform(-5.f, 5.f);
+    static const int LENGTH_SETS[3][4] = {{3, 5, 7, 31}, {31, 3, 5, 13}, {1, 1, 1, 1}};
+    for (int set = 0; set < 3; set++) {
+        filter.setLengths(LENGTH_SETS[set]);
+        CHECK(filter.active == (set < 2));
+        for (int i = 0; i < 200; i++) {
+            simd::float_4 in(uniform(rng), uniform(rng), uniform(rng), uniform(rng));
+            simd::float_4 out = filter.process(in);
+            for (int c = 0; c < 4; c++) {
+                history[c].push_back(in[c]);
+                CHECK(out[c] == referenceMedian(history[c], LENGTH_SETS[set][c]));
+            }
+        }
+    }
+}
+
+TEST(medianFilterDuplicates) {
+    // Repeated values exercise the equal-key paths of the sorted window
+    MedianFilter filter;
+    int lengths[4] = {7, 7, 31, 31};
+    filter.setLengths(lengths);
+    std::vector<float> history[4];
+    for (int i = 0; i < MedianFilter::RING_SIZE; i++) {
+        filter.process(0.f);
+        for (int c = 0; c < 4; c++) {
+            history[c].push_back(0.f);
+        }
+    }
+    std::mt19937 rng(2);
+    std::uniform_int_distribution<int> level(-2, 2);
+    for (int i = 0; i < 500; i++) {
+        simd::float_4 in((float) level(rng), (float) level(rng), (float) level(rng), (float) level(rng));
+        simd::float_4 out = filter.process(in);
+        for (int c = 0; c < 4; c++) {
+            history[c].push_back(in[c]);
+            CHECK(out[c] == referenceMedian(history[c], lengths[c]));
+        }
+    }
+}
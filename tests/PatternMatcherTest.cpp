@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2025 ifnoon
+// Part of the ifnoon VCV Rack plugin project.
+
+/*
+ * PatternMatcherTest.cpp - Tests for the Pattern Compiler and Matcher
+ */
+
+#include "test.hpp"
+#include "PatternMatcher.hpp"
+#include <cmath>
+
+static const char* const GATE_NAMES[] = {"A_HI", "B_HI", "C_HI", "D_HI"};
+static const int NUM_GATES = 4;
+
+static bool compile(const std::string& text, PatternProgram* program, std::string* error = nullptr) {
+    std::string ignored;
+    return compilePattern(text, GATE_NAMES, NUM_GATES, program, error ? error : &ignored);
+}
+
+TEST(patternParser) {
+    PatternProgram program;
+    CHECK(compile("+A_HI -b_hi/50, +D_HI/1.5", &program));
+    CHECK(program.length == 3);
+    CHECK(program.riseSteps[0] == 1);
+    CHECK(program.fallSteps[1] == 2);
+    CHECK(program.riseSteps[3] == 4);
+    CHECK(program.riseSteps[1] == 0 && program.fallSteps[0] == 0);
+    CHECK(std::fabs(program.timeouts[0] - 0.05f) < 1e-6f);
+    CHECK(std::fabs(program.timeouts[1] - 0.0015f) < 1e-6f);
+    CHECK(program.timedMask == 3);
+    CHECK(program.lastGate == 3 && program.lastRising);
+
+    // The same gate may appear in several steps
+    CHECK(compile("+A_HI -A_HI +A_HI", &program));
+    CHECK(program.riseSteps[0] == 5 && program.fallSteps[0] == 2);
+
+    // An empty pattern compiles to no pattern
+    CHECK(compile("  ", &program));
+    CHECK(program.length == 0);
+
+    // Errors leave the previous program alone
+    PatternProgram kept;
+    compile("+C_HI", &kept);
+    std::string error;
+    CHECK(!compile("A_HI", &kept, &error));
+    CHECK(error.find("start each step") != std::string::npos);
+    CHECK(!compile("+E_HI", &kept, &error));
+    CHECK(error.find("unknown gate") != std::string::npos);
+    CHECK(!compile("+A_HI/10", &kept, &error));
+    CHECK(error.find("first step") != std::string::npos);
+    CHECK(!compile("+A_HI +B_HI/0", &kept));
+    CHECK(!compile("+A_HI +B_HI/", &kept));
+    CHECK(!compile("+A_HI +B_HI/10x", &kept));
+    CHECK(!compile("+A_HI +B_HI/60001", &kept));
+    CHECK(compile("+A_HI +B_HI/60000", &program));
+    CHECK(kept.length == 1 && kept.riseSteps[2] == 1);
+
+    std::string longest;
+    for (int i = 0; i < PatternProgram::MAX_STEPS; i++) {
+        longest += "+A_HI ";
+    }
+    CHECK(compile(longest, &program));
+    CHECK(program.length == PatternProgram::MAX_STEPS);
+    CHECK(!compile(longest + "+A_HI", &program, &error));
+    CHECK(error.find("64 steps") != std::string::npos);
+}
+
+TEST(patternMatcherTimeouts) {
+    // At 1 kHz a 10 ms timeout is 10 samples
+    PatternProgram program;
+    CHECK(compile("+A_HI +B_HI/10 -A_HI", &program));
+    PatternMatcher matcher;
+    matcher.setProgram(&program, 1000.f);
+    CHECK(matcher.timeoutSamples[0] == 10);
+
+    // In order, within the timeout
+    CHECK(!matcher.process(1, 0));
+    for (int i = 0; i < 5; i++) {
+        CHECK(!matcher.process(0, 0));
+    }
+    CHECK(!matcher.process(2, 0));
+    CHECK(matcher.process(0, 1));
+    // A match clears the partial matches
+    CHECK(matcher.active == 0);
+    CHECK(!matcher.process(0, 1));
+
+    // Out of order
+    CHECK(!matcher.process(2, 0));
+    CHECK(!matcher.process(1, 0));
+    CHECK(!matcher.process(0, 1));
+    matcher.reset();
+
+    // Too late: the prefix expires and B no longer advances
+    CHECK(!matcher.process(1, 0));
+    for (int i = 0; i < 20; i++) {
+        CHECK(!matcher.process(0, 0));
+    }
+    CHECK(matcher.active == 0);
+    CHECK(!matcher.process(2, 0));
+    CHECK(!matcher.process(0, 1));
+
+    // The timeout restarts when the first step happens again
+    CHECK(!matcher.process(1, 0));
+    for (int i = 0; i < 8; i++) {
+        CHECK(!matcher.process(0, 0));
+    }
+    CHECK(!matcher.process(1, 0));
+    for (int i = 0; i < 8; i++) {
+        CHECK(!matcher.process(0, 0));
+    }
+    CHECK(!matcher.process(2, 0));
+    CHECK(matcher.process(0, 1));
+
+    // Simultaneous edges advance one step per sample only
+    matcher.reset();
+    CHECK(!matcher.process(3, 0));
+    CHECK(matcher.active == 1);
+
+    // The sample rate rescales the timeouts
+    matcher.setSampleRate(48000.f);
+    CHECK(matcher.timeoutSamples[0] == 480);
+
+    // No program: never matches
+    matcher.setProgram(nullptr, 1000.f);
+    CHECK(!matcher.process(1, 0));
+}
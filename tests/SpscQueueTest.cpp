@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2025 ifnoon
+// Part of the ifnoon VCV Rack plugin project.
+
+/*
+ * SpscQueueTest.cpp - Tests for the Single-Producer/Single-Consumer Queue
+ */
+
+#include "test.hpp"
+#include "SpscQueue.hpp"
+#include <thread>
+
+TEST(spscQueueCapacity) {
+    SpscQueue<int, 8> queue;
+    int item = 0;
+    CHECK(!queue.pop(item));
+    for (int i = 0; i < 8; i++) {
+        CHECK(queue.push(i));
+    }
+    // Full: push fails instead of overwriting
+    CHECK(!queue.push(8));
+    CHECK(queue.size() == 8);
+    for (int i = 0; i < 8; i++) {
+        CHECK(queue.pop(item) && item == i);
+    }
+    CHECK(!queue.pop(item));
+    CHECK(queue.size() == 0);
+}
+
+TEST(spscQueueThreads) {
+    // One producer and one consumer thread: every item, in order
+    static const int NUM_ITEMS = 200000;
+    SpscQueue<int, 64> queue;
+    std::thread producer([&]() {
+        for (int i = 0; i < NUM_ITEMS; i++) {
+            while (!queue.push(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    int expected = 0;
+    bool ordered = true;
+    int item = 0;
+    while (expected < NUM_ITEMS) {
+        if (queue.pop(item)) {
+            ordered = ordered && (item == expected);
+            expected++;
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    CHECK(ordered);
+    CHECK(!queue.pop(item));
+}
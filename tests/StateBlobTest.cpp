@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2025 ifnoon
+// Part of the ifnoon VCV Rack plugin project.
+
+/*
+ * StateBlobTest.cpp - Tests for the Runtime State Blob Writer/Reader
+ */
+
+#include "test.hpp"
+#include "StateBlob.hpp"
+
+TEST(stateBlobRoundTrip) {
+    StateBlobWriter writer;
+    writer.putU32(8);
+    writer.putU32(0xdeadbeef);
+    writer.putFloat(-1.25f);
+    writer.putFloat4(simd::float_4(1.f, -2.f, 3.5f, 1e-20f));
+    std::string base64 = writer.toBase64();
+    CHECK(writer.bytes.size() == 28);
+
+    StateBlobReader reader(base64.c_str());
+    uint32_t version = 0, word = 0;
+    float value = 0.f;
+    simd::float_4 values = 0.f;
+    CHECK(reader.getU32(version) && version == 8);
+    CHECK(reader.getU32(word) && word == 0xdeadbeef);
+    CHECK(reader.getFloat(value) && value == -1.25f);
+    CHECK(reader.getFloat4(values));
+    CHECK(values[0] == 1.f && values[1] == -2.f && values[2] == 3.5f && values[3] == 1e-20f);
+
+    // Past the end the reader fails and leaves the destinations alone
+    word = 7;
+    values = 9.f;
+    CHECK(!reader.getU32(word) && word == 7);
+    CHECK(!reader.getFloat4(values) && values[0] == 9.f);
+}
+
+TEST(stateBlobTruncated) {
+    // A truncated float_4 is not half-read
+    StateBlobWriter writer;
+    writer.putFloat(1.f);
+    writer.putFloat(2.f);
+    StateBlobReader reader(writer.toBase64().c_str());
+    simd::float_4 values = 9.f;
+    CHECK(!reader.getFloat4(values) && values[0] == 9.f && values[1] == 9.f);
+
+    // No blob reads as an empty one
+    StateBlobReader missing(nullptr);
+    uint32_t word = 7;
+    CHECK(!missing.getU32(word) && word == 7);
+}
@@ -0,0 +1,26 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2025 ifnoon
+// Part of the ifnoon VCV Rack plugin project.
+
+/*
+ * main.cpp - Unit Test Runner for ifnoon Modules
+ *
+ * Runs every registered TEST() and exits non-zero when a check failed.
+ * Built and run by `make test` against the Rack SDK.
+ */
+
+#include "test.hpp"
+
+int main() {
+    for (TestCase* test : TestCase::registry()) {
+        int before = TestCase::failures();
+        test->run();
+        std::printf("%-40s %s\n", test->name, (TestCase::failures() == before) ? "ok" : "FAILED");
+    }
+    if (TestCase::failures()) {
+        std::fprintf(stderr, "%d check(s) failed\n", TestCase::failures());
+        return 1;
+    }
+    std::printf("All tests passed\n");
+    return 0;
+}
@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Copyright (c) 2025 ifnoon
+// Part of the ifnoon VCV Rack plugin project.
+
+/*
+ * test.hpp - Minimal Unit Test Harness for ifnoon Modules
+ *
+ * Each test source under tests/ defines TEST(name) functions that register
+ * themselves; tests/main.cpp runs them all. CHECK() records a failure and
+ * carries on, so one run reports every broken expectation.
+ */
+
+#pragma once
+
+#include <cstdio>
+#include <vector>
+
+struct TestCase {
+    const char* name;
+    void (*run)();
+
+    TestCase(const char* name, void (*run)()) : name(name), run(run) {
+        registry().push_back(this);
+    }
+
+    static std::vector<TestCase*>& registry() {
+        static std::vector<TestCase*> cases;
+        return cases;
+    }
+
+    static int& failures() {
+        static int count = 0;
+        return count;
+    }
+};
+
+#define TEST(name) \
+    static void name(); \
+    static TestCase name##Case(#name, name); \
+    static void name()
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            TestCase::failures()++; \
+        } \
+    } while (0)